@@ -0,0 +1,76 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "Classifier.h"
+#include "ClassifierParallel.h"
+
+// Shape of the kernel, set per build by the Makefile
+#ifndef KERNEL_NAME
+#define KERNEL_NAME Classifier_0
+#endif
+#ifndef NUM_CLASSES_MAX
+#define NUM_CLASSES_MAX 64
+#endif
+#ifndef NUM_FEATURES_MAX
+#define NUM_FEATURES_MAX 4096
+#endif
+#ifndef VECTOR_SIZE
+#define VECTOR_SIZE 8
+#endif
+#ifndef CHUNK
+#define CHUNK 8
+#endif
+// Set CLASSES_PARALLEL to build classifierParallel instead
+#ifndef EXAMPLES_PARALLEL
+#define EXAMPLES_PARALLEL 4
+#endif
+
+typedef ap_int<32 * VECTOR_SIZE> floatV;
+
+// One compute unit; the Makefile builds this source once per CU, each with
+// its own KERNEL_NAME, so the CUs are Classifier_0 .. Classifier_<CUS - 1>
+extern "C" {
+void KERNEL_NAME(floatV *_features, floatV *_means, floatV *_variances,
+                 float *_priors, int *_prediction, float epsilon,
+                 int numClasses, int numFeatures, int chunkSize) {
+#pragma HLS INTERFACE m_axi port = _features offset = slave bundle = gmem0
+#pragma HLS INTERFACE m_axi port = _means offset = slave bundle = gmem1
+#pragma HLS INTERFACE m_axi port = _variances offset = slave bundle = gmem2
+#pragma HLS INTERFACE m_axi port = _priors offset = slave bundle = gmem3
+#pragma HLS INTERFACE m_axi port = _prediction offset = slave bundle = gmem4
+#pragma HLS INTERFACE s_axilite port = _features bundle = control
+#pragma HLS INTERFACE s_axilite port = _means bundle = control
+#pragma HLS INTERFACE s_axilite port = _variances bundle = control
+#pragma HLS INTERFACE s_axilite port = _priors bundle = control
+#pragma HLS INTERFACE s_axilite port = _prediction bundle = control
+#pragma HLS INTERFACE s_axilite port = epsilon bundle = control
+#pragma HLS INTERFACE s_axilite port = numClasses bundle = control
+#pragma HLS INTERFACE s_axilite port = numFeatures bundle = control
+#pragma HLS INTERFACE s_axilite port = chunkSize bundle = control
+#pragma HLS INTERFACE s_axilite port = return bundle = control
+
+#ifdef CLASSES_PARALLEL
+  classifierParallel<NUM_CLASSES_MAX, NUM_FEATURES_MAX, VECTOR_SIZE,
+                     CLASSES_PARALLEL, EXAMPLES_PARALLEL>(
+      _features, _means, _variances, _priors, _prediction, epsilon, numClasses,
+      numFeatures, chunkSize);
+#else
+  classifier<NUM_CLASSES_MAX, NUM_FEATURES_MAX, VECTOR_SIZE, CHUNK>(
+      _features, _means, _variances, _priors, _prediction, epsilon, numClasses,
+      numFeatures, chunkSize);
+#endif
+}
+}
@@ -14,47 +14,52 @@
 * limitations under the License.
 */
 
+#ifndef CLASSIFIER_H
+#define CLASSIFIER_H
+
 #include <ap_int.h>
 #include <math.h>
 
-#define numClassesMax 64
-#define numFeaturesMax 512
-#define vectorSize 8
-#define chunk 8
-
-typedef ap_int<256> float8;
-
-union {
-  int asInt;
-  float asFloat;
-} converter0, converter1, converter2;
-
-extern "C" {
-void Classifier_0(float8 *_features, float8 *_means, float8 *_variances,
-                  float *_priors, int *_prediction, float epsilon,
-                  int numClasses, int numFeatures, int chunkSize) {
-#pragma HLS INTERFACE m_axi port = _features offset = slave bundle = gmem0
-#pragma HLS INTERFACE m_axi port = _means offset = slave bundle = gmem1
-#pragma HLS INTERFACE m_axi port = _variances offset = slave bundle = gmem2
-#pragma HLS INTERFACE m_axi port = _priors offset = slave bundle = gmem3
-#pragma HLS INTERFACE m_axi port = _prediction offset = slave bundle = gmem4
-#pragma HLS INTERFACE s_axilite port = _features bundle = control
-#pragma HLS INTERFACE s_axilite port = _means bundle = control
-#pragma HLS INTERFACE s_axilite port = _variances bundle = control
-#pragma HLS INTERFACE s_axilite port = _priors bundle = control
-#pragma HLS INTERFACE s_axilite port = _prediction bundle = control
-#pragma HLS INTERFACE s_axilite port = epsilon bundle = control
-#pragma HLS INTERFACE s_axilite port = numClasses bundle = control
-#pragma HLS INTERFACE s_axilite port = numFeatures bundle = control
-#pragma HLS INTERFACE s_axilite port = chunksize bundle = control
-#pragma HLS INTERFACE s_axilite port = return bundle = control
+#include "Cycles.h"
+
+#define VECTORIZATION 8 // Host padding of feature rows, in floats
+
+// Depth of the pairwise adder tree over n lanes
+constexpr int adderLevels(int n) { return (n > 1) ? 1 + adderLevels(n / 2) : 0; }
+
+/**
+* Gaussian NaiveBayes scoring of chunkSize padded examples, chunk examples at
+* a time, with the model held on chip. chunkSize is a multiple of
+* VECTORIZATION, not of chunk: the last pass may score fewer examples.
+*
+* vectorSize floats arrive per memory word, so a row is
+* roundup(numFeatures, VECTORIZATION) / vectorSize words; vectorSize must
+* divide VECTORIZATION. numFeaturesMax is in floats. The top-level kernel
+* functions declare the interfaces and call this.
+*/
+template <int numClassesMax, int numFeaturesMax, int vectorSize, int chunk>
+void classifier(ap_int<32 * vectorSize> *_features,
+                ap_int<32 * vectorSize> *_means,
+                ap_int<32 * vectorSize> *_variances, float *_priors,
+                int *_prediction, float epsilon, int numClasses,
+                int numFeatures, int chunkSize) {
+  typedef ap_int<32 * vectorSize> floatV;
+  const int numVectorsMax = numFeaturesMax / vectorSize;
+
+  static_assert(VECTORIZATION % vectorSize == 0,
+                "vectorSize must divide the host row padding");
+
+  union {
+    int asInt;
+    float asFloat;
+  } converter0, converter1, converter2;
 
   int prediction[chunk];
   float d_Pi = 2 * M_PI;
   float priors[numClassesMax], max_likelihood[chunk],
       numerator[numClassesMax][chunk * vectorSize];
-  float8 means[numClassesMax][numFeaturesMax],
-      variances[numClassesMax][numFeaturesMax], features[chunk][numFeaturesMax];
+  floatV means[numClassesMax][numVectorsMax],
+      variances[numClassesMax][numVectorsMax], features[chunk][numVectorsMax];
 
 // Using URAMs for features, means and variances buffers
 #pragma HLS resource variable = features core = XPM_MEMORY uram
@@ -65,8 +70,9 @@ void Classifier_0(float8 *_features, float8 *_means, float8 *_variances,
 #pragma HLS array_partition variable = features complete dim = 1
 #pragma HLS array_partition variable = numerator complete dim = 2
 
-  int numFeatures8 =
-      (((numFeatures) + (vectorSize - 1)) & (~(vectorSize - 1))) >> 3;
+  int numFeaturesV =
+      (((numFeatures) + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1))) /
+      vectorSize;
   int numClassesMin = (13 > numClasses) ? 13 : numClasses;
 
   for (int k = 0; k < numClasses; k++) {
@@ -74,35 +80,41 @@ void Classifier_0(float8 *_features, float8 *_means, float8 *_variances,
 #pragma HLS pipeline II = 1
     priors[k] = _priors[k];
   }
+  CYCLES(numClasses, 1, LATENCY_AXI);
 
   for (int k = 0; k < numClasses; k++) {
 #pragma HLS loop_tripcount min = 10 max = 10
-    for (int j = 0; j < numFeatures8; j++) {
+    for (int j = 0; j < numFeaturesV; j++) {
 #pragma HLS loop_tripcount min = 98 max = 98
 #pragma HLS pipeline II = 1
-      means[k][j] = _means[k * numFeatures8 + j];
-      variances[k][j] = _variances[k * numFeatures8 + j];
+      means[k][j] = _means[k * numFeaturesV + j];
+      variances[k][j] = _variances[k * numFeaturesV + j];
     }
+    CYCLES(numFeaturesV, 1, LATENCY_AXI);
   }
 
-  for (int i = 0; i < chunkSize / chunk; i++) {
+  for (int i = 0; i < (chunkSize + chunk - 1) / chunk; i++) {
 #pragma HLS loop_tripcount min = 1250 max = 1250
-    int offset = (i * chunk) * numFeatures8;
+    int offset = (i * chunk) * numFeaturesV;
+    int rows = (chunkSize - i * chunk < chunk) ? chunkSize - i * chunk : chunk;
 
     for (int c = 0; c < chunk; c++) {
 #pragma HLS unroll
       max_likelihood[c] = -INFINITY;
     }
+    CYCLES(1, 1, 1);
 
-    for (int cj = 0, c = 0, j = 0; cj < chunk * numFeatures8; cj++, j++) {
+    // A short pass reads only its rows, the others are scored but not written
+    for (int cj = 0, c = 0, j = 0; cj < rows * numFeaturesV; cj++, j++) {
 #pragma HLS loop_tripcount min = 784 max = 784
 #pragma HLS pipeline II = 1
-      if (j == numFeatures8) {
+      if (j == numFeaturesV) {
         j = 0;
         c++;
       }
       features[c][j] = _features[offset + cj];
     }
+    CYCLES(rows * numFeaturesV, 1, LATENCY_AXI);
 
     for (int k = 0; k < numClasses; k++) {
 #pragma HLS loop_tripcount min = 10 max = 10
@@ -115,8 +127,9 @@ void Classifier_0(float8 *_features, float8 *_means, float8 *_variances,
         }
       }
     }
+    CYCLES(numClasses, 1, LATENCY_FLOG);
 
-    for (int j = 0; j < numFeatures8; j++) {
+    for (int j = 0; j < numFeaturesV; j++) {
 #pragma HLS loop_tripcount min = 98 max = 98
       for (int k = 0; k < numClassesMin; k++) {
 #pragma HLS loop_tripcount min = 13 max = 13
@@ -140,6 +153,9 @@ void Classifier_0(float8 *_features, float8 *_means, float8 *_variances,
           }
         }
       }
+      CYCLES(numClassesMin, 1,
+             LATENCY_FADD + LATENCY_FMUL + LATENCY_FLOG + LATENCY_FMUL +
+                 2 * LATENCY_FADD);
     }
 
     for (int k = 0; k < numClasses; k++) {
@@ -147,32 +163,37 @@ void Classifier_0(float8 *_features, float8 *_means, float8 *_variances,
       for (int c = 0; c < chunk; c++) {
 #pragma HLS loop_tripcount min = 8 max = 8
 #pragma HLS pipeline II = 1
-        float adder0_0 =
-            numerator[k][c * vectorSize] + numerator[k][c * vectorSize + 1];
-        float adder0_1 =
-            numerator[k][c * vectorSize + 2] + numerator[k][c * vectorSize + 3];
-        float adder0_2 =
-            numerator[k][c * vectorSize + 4] + numerator[k][c * vectorSize + 5];
-        float adder0_3 =
-            numerator[k][c * vectorSize + 6] + numerator[k][c * vectorSize + 7];
+        float adder[vectorSize];
+#pragma HLS array_partition variable = adder complete
 
-        float adder1_0 = adder0_0 + adder0_1;
-        float adder1_1 = adder0_2 + adder0_3;
+        for (int t = 0; t < vectorSize; t++) {
+          adder[t] = numerator[k][c * vectorSize + t];
+        }
+
+        // Pairwise adder tree, log2(vectorSize) levels deep
+        for (int width = vectorSize / 2; width > 0; width /= 2) {
+          for (int t = 0; t < width; t++) {
+            adder[t] = adder[2 * t] + adder[2 * t + 1];
+          }
+        }
 
-        float result = adder1_0 + adder1_1;
+        float result = adder[0];
 
         if (result > max_likelihood[c]) {
           max_likelihood[c] = result;
           prediction[c] = k;
         }
       }
+      CYCLES(chunk, 1, adderLevels(vectorSize) * LATENCY_FADD + 2);
     }
 
-    for (int c = 0; c < chunk; c++) {
+    for (int c = 0; c < rows; c++) {
 #pragma HLS loop_tripcount min = 8 max = 8
 #pragma HLS pipeline II = 1
       _prediction[i * chunk + c] = prediction[c];
     }
+    CYCLES(rows, 1, 1);
   }
 }
-}
+
+#endif // CLASSIFIER_H
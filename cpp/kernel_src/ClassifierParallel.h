@@ -0,0 +1,280 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef CLASSIFIERPARALLEL_H
+#define CLASSIFIERPARALLEL_H
+
+#include <ap_int.h>
+#include <math.h>
+
+#include "Classifier.h"
+#include "Cycles.h"
+
+// Iterations between two updates of an accumulator: the depth of the whole
+// update, a subtract, two multiplies and the accumulating subtract
+#define ACCUMULATION_LATENCY (2 * LATENCY_FADD + 2 * LATENCY_FMUL)
+
+/**
+* Class-parallel variant of classifier.
+*
+* classifier pads its pipelined class loop to 13 iterations so that an
+* accumulator is not updated again before its last update completes, which
+* wastes most cycles below 13 classes. Here every iteration scores
+* classesParallel classes against examplesParallel examples, and a pass
+* interleaves as many groups of examplesParallel examples as it takes to
+* space the updates of an accumulator ACCUMULATION_LATENCY iterations apart.
+* The scoring of a pass is one pipeline of numFeaturesV * classGroups *
+* exampleGroups cycles for examplesParallel * exampleGroups examples, so the
+* cost of an example scales with classGroups = ceil(numClasses /
+* classesParallel), on top of the numFeaturesV cycles of reading it.
+*
+* The per-class terms are precomputed while the model is loaded, as the CPU
+* engine does, so the inner loop is two multiplies and two adds per lane.
+*/
+template <int numClassesMax, int numFeaturesMax, int vectorSize,
+          int classesParallel, int examplesParallel>
+void classifierParallel(ap_int<32 * vectorSize> *_features,
+                        ap_int<32 * vectorSize> *_means,
+                        ap_int<32 * vectorSize> *_variances, float *_priors,
+                        int *_prediction, float epsilon, int numClasses,
+                        int numFeatures, int chunkSize) {
+  const int numVectorsMax = numFeaturesMax / vectorSize;
+  const int classGroupsMax =
+      (numClassesMax + classesParallel - 1) / classesParallel;
+  const int examplesMax = examplesParallel * ACCUMULATION_LATENCY;
+
+  static_assert(VECTORIZATION % vectorSize == 0,
+                "vectorSize must divide the host row padding");
+
+  union {
+    int asInt;
+    float asFloat;
+  } converter0, converter1;
+
+  int prediction[examplesMax];
+  float d_Pi = 2 * M_PI;
+  float constants[classGroupsMax * classesParallel],
+      max_likelihood[examplesMax];
+  float means[classGroupsMax * classesParallel][numVectorsMax][vectorSize],
+      coefficients[classGroupsMax * classesParallel][numVectorsMax]
+                  [vectorSize],
+      features[examplesMax][numVectorsMax][vectorSize],
+      numerator[classGroupsMax * classesParallel][examplesMax][vectorSize];
+
+// Using URAMs for features, means and coefficients buffers
+#pragma HLS resource variable = features core = XPM_MEMORY uram
+#pragma HLS resource variable = means core = XPM_MEMORY uram
+#pragma HLS resource variable = coefficients core = XPM_MEMORY uram
+
+// One bank per class, example and lane read in the same cycle
+#pragma HLS array_partition variable = means cyclic factor = classesParallel dim = 1
+#pragma HLS array_partition variable = means complete dim = 3
+#pragma HLS array_partition variable = coefficients cyclic factor = classesParallel dim = 1
+#pragma HLS array_partition variable = coefficients complete dim = 3
+#pragma HLS array_partition variable = features cyclic factor = examplesParallel dim = 1
+#pragma HLS array_partition variable = features complete dim = 3
+#pragma HLS array_partition variable = numerator cyclic factor = classesParallel dim = 1
+#pragma HLS array_partition variable = numerator cyclic factor = examplesParallel dim = 2
+#pragma HLS array_partition variable = numerator complete dim = 3
+
+  int numFeaturesV =
+      (((numFeatures) + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1))) /
+      vectorSize;
+  int classGroups = (numClasses + classesParallel - 1) / classesParallel;
+  int exampleGroups =
+      (ACCUMULATION_LATENCY + classGroups - 1) / classGroups;
+  int examplesPass = exampleGroups * examplesParallel;
+
+  // Like classifier, the padded features take part in the constants
+  for (int k = 0; k < numClasses; k++) {
+#pragma HLS loop_tripcount min = 10 max = 10
+    float partial[vectorSize];
+#pragma HLS array_partition variable = partial complete
+
+    for (int t = 0; t < vectorSize; t++) {
+#pragma HLS unroll
+      partial[t] = 0.0f;
+    }
+
+    for (int j = 0; j < numFeaturesV; j++) {
+#pragma HLS loop_tripcount min = 98 max = 98
+#pragma HLS pipeline
+      for (int t = 0; t < vectorSize; t++) {
+        converter0.asInt = _means[k * numFeaturesV + j].range((t + 1) * 32 - 1, t * 32);
+        converter1.asInt = _variances[k * numFeaturesV + j].range((t + 1) * 32 - 1, t * 32);
+
+        float dPiVariances = d_Pi * (converter1.asFloat + epsilon);
+        float variancesD = 2.0f * (converter1.asFloat + epsilon);
+
+        means[k][j][t] = converter0.asFloat;
+        coefficients[k][j][t] = variancesD ? 1.0f / variancesD : 0;
+        partial[t] += dPiVariances ? 0.5f * logf(dPiVariances) : 0;
+      }
+    }
+    CYCLES(numFeaturesV, LATENCY_FADD,
+           LATENCY_AXI + LATENCY_FADD + LATENCY_FMUL + LATENCY_FLOG);
+
+    for (int width = vectorSize / 2; width > 0; width /= 2) {
+      for (int t = 0; t < width; t++) {
+#pragma HLS unroll
+        partial[t] = partial[2 * t] + partial[2 * t + 1];
+      }
+    }
+
+    constants[k] = logf(_priors[k]) - partial[0];
+    CYCLES(1, 1, LATENCY_AXI + LATENCY_FLOG + adderLevels(vectorSize) * LATENCY_FADD);
+  }
+
+  // The classes that pad the last group are scored against a zero model
+  for (int kj = 0, k = numClasses, j = 0;
+       kj < (classGroups * classesParallel - numClasses) * numFeaturesV;
+       kj++, j++) {
+#pragma HLS loop_tripcount min = 0 max = 98
+#pragma HLS pipeline II = 1
+    if (j == numFeaturesV) {
+      j = 0;
+      k++;
+    }
+
+    for (int t = 0; t < vectorSize; t++) {
+      means[k][j][t] = 0.0f;
+      coefficients[k][j][t] = 0.0f;
+    }
+  }
+  CYCLES((classGroups * classesParallel - numClasses) * numFeaturesV, 1, 1);
+
+  for (int base = 0; base < chunkSize; base += examplesPass) {
+#pragma HLS loop_tripcount min = 1024 max = 1024
+    int rows = (chunkSize - base < examplesPass) ? chunkSize - base : examplesPass;
+    int offset = base * numFeaturesV;
+
+    for (int ej = 0, e = 0, j = 0; ej < rows * numFeaturesV; ej++, j++) {
+#pragma HLS loop_tripcount min = 392 max = 392
+#pragma HLS pipeline II = 1
+      if (j == numFeaturesV) {
+        j = 0;
+        e++;
+      }
+
+      for (int t = 0; t < vectorSize; t++) {
+        converter0.asInt = _features[offset + ej].range((t + 1) * 32 - 1, t * 32);
+        features[e][j][t] = converter0.asFloat;
+      }
+    }
+    CYCLES(rows * numFeaturesV, 1, LATENCY_AXI);
+
+    // As do the examples that pad a short pass against every class
+    for (int ej = 0, e = rows, j = 0; ej < (examplesPass - rows) * numFeaturesV;
+         ej++, j++) {
+#pragma HLS loop_tripcount min = 0 max = 98
+#pragma HLS pipeline II = 1
+      if (j == numFeaturesV) {
+        j = 0;
+        e++;
+      }
+
+      for (int t = 0; t < vectorSize; t++) {
+        features[e][j][t] = 0.0f;
+      }
+    }
+    CYCLES((examplesPass - rows) * numFeaturesV, 1, 1);
+
+    // Every iteration updates classesParallel x examplesParallel x vectorSize
+    // accumulators, which come back classGroups * exampleGroups iterations
+    // later, so the features, class groups and example groups flatten into
+    // one pipeline that drains once per pass
+    for (int jge = 0, j = 0, g = 0, e = 0;
+         jge < numFeaturesV * classGroups * exampleGroups; jge++, e++) {
+#pragma HLS loop_tripcount min = 1274 max = 1274
+#pragma HLS pipeline II = 1
+#pragma HLS dependence variable = numerator inter false
+      if (e == exampleGroups) {
+        e = 0;
+        g++;
+      }
+      if (g == classGroups) {
+        g = 0;
+        j++;
+      }
+
+      for (int p = 0; p < classesParallel; p++) {
+        int k = g * classesParallel + p;
+
+        for (int x = 0; x < examplesParallel; x++) {
+          int example = e * examplesParallel + x;
+
+          for (int t = 0; t < vectorSize; t++) {
+            float difference = features[example][j][t] - means[k][j][t];
+            float previous = j ? numerator[k][example][t] : 0.0f;
+
+            numerator[k][example][t] =
+                previous - coefficients[k][j][t] * difference * difference;
+          }
+        }
+      }
+    }
+    CYCLES(numFeaturesV * classGroups * exampleGroups, 1, ACCUMULATION_LATENCY);
+
+    for (int e = 0; e < rows; e++) {
+#pragma HLS loop_tripcount min = 52 max = 52
+#pragma HLS unroll factor = examplesParallel
+      max_likelihood[e] = -INFINITY;
+    }
+    CYCLES((rows + examplesParallel - 1) / examplesParallel, 1, 1);
+
+    // The examples of a pass are at least examplesParallel apart on the
+    // comparison with max_likelihood
+    for (int ke = 0, k = 0, e = 0; ke < numClasses * rows; ke++, e++) {
+#pragma HLS loop_tripcount min = 520 max = 520
+#pragma HLS pipeline II = 1
+      if (e == rows) {
+        e = 0;
+        k++;
+      }
+
+      float adder[vectorSize];
+#pragma HLS array_partition variable = adder complete
+
+      for (int t = 0; t < vectorSize; t++) {
+        adder[t] = numerator[k][e][t];
+      }
+
+      // Pairwise adder tree, log2(vectorSize) levels deep
+      for (int width = vectorSize / 2; width > 0; width /= 2) {
+        for (int t = 0; t < width; t++) {
+          adder[t] = adder[2 * t] + adder[2 * t + 1];
+        }
+      }
+
+      float result = constants[k] + adder[0];
+
+      if (result > max_likelihood[e]) {
+        max_likelihood[e] = result;
+        prediction[e] = k;
+      }
+    }
+    CYCLES(numClasses * rows, 1, (adderLevels(vectorSize) + 1) * LATENCY_FADD + 2);
+
+    for (int e = 0; e < rows; e++) {
+#pragma HLS loop_tripcount min = 52 max = 52
+#pragma HLS pipeline II = 1
+      _prediction[base + e] = prediction[e];
+    }
+    CYCLES(rows, 1, 1);
+  }
+}
+
+#endif // CLASSIFIERPARALLEL_H
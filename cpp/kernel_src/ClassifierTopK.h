@@ -0,0 +1,234 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef CLASSIFIERTOPK_H
+#define CLASSIFIERTOPK_H
+
+#include <ap_int.h>
+#include <math.h>
+
+#include "Classifier.h"
+#include "Cycles.h"
+
+/**
+* Variant of classifier that returns the topK best classes of every example
+* with their normalized log posteriors, instead of the best class alone.
+*
+* The scores of an example are reduced as they come out of the adder tree,
+* into a shift register of the topKMax best and a running log-sum-exp,
+* rescaled whenever the maximum moves. _classes and _logProbabilities are
+* [chunkSize][topK]; a topK above topKMax is clamped to topKMax, which then
+* is the row length of both.
+*/
+template <int numClassesMax, int numFeaturesMax, int vectorSize, int chunk,
+          int topKMax>
+void classifierTopK(ap_int<32 * vectorSize> *_features,
+                    ap_int<32 * vectorSize> *_means,
+                    ap_int<32 * vectorSize> *_variances, float *_priors,
+                    int *_classes, float *_logProbabilities, float epsilon,
+                    int numClasses, int numFeatures, int chunkSize, int topK) {
+  typedef ap_int<32 * vectorSize> floatV;
+  const int numVectorsMax = numFeaturesMax / vectorSize;
+
+  static_assert(VECTORIZATION % vectorSize == 0,
+                "vectorSize must divide the host row padding");
+
+  union {
+    int asInt;
+    float asFloat;
+  } converter0, converter1, converter2;
+
+  int topClass[chunk][topKMax];
+  float d_Pi = 2 * M_PI;
+  float priors[numClassesMax], maximum[chunk], sum[chunk],
+      topScore[chunk][topKMax], numerator[numClassesMax][chunk * vectorSize];
+  floatV means[numClassesMax][numVectorsMax],
+      variances[numClassesMax][numVectorsMax], features[chunk][numVectorsMax];
+
+// Using URAMs for features, means and variances buffers
+#pragma HLS resource variable = features core = XPM_MEMORY uram
+#pragma HLS resource variable = means core = XPM_MEMORY uram
+#pragma HLS resource variable = variances core = XPM_MEMORY uram
+
+// Partitioning the local arrays
+#pragma HLS array_partition variable = features complete dim = 1
+#pragma HLS array_partition variable = numerator complete dim = 2
+#pragma HLS array_partition variable = topClass complete dim = 0
+#pragma HLS array_partition variable = topScore complete dim = 0
+
+  // The output rows are topKMax long at most
+  if (topK > topKMax) topK = topKMax;
+
+  int numFeaturesV =
+      (((numFeatures) + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1))) /
+      vectorSize;
+  int numClassesMin = (13 > numClasses) ? 13 : numClasses;
+
+  for (int k = 0; k < numClasses; k++) {
+#pragma HLS loop_tripcount min = 10 max = 10
+#pragma HLS pipeline II = 1
+    priors[k] = _priors[k];
+  }
+  CYCLES(numClasses, 1, LATENCY_AXI);
+
+  for (int k = 0; k < numClasses; k++) {
+#pragma HLS loop_tripcount min = 10 max = 10
+    for (int j = 0; j < numFeaturesV; j++) {
+#pragma HLS loop_tripcount min = 98 max = 98
+#pragma HLS pipeline II = 1
+      means[k][j] = _means[k * numFeaturesV + j];
+      variances[k][j] = _variances[k * numFeaturesV + j];
+    }
+    CYCLES(numFeaturesV, 1, LATENCY_AXI);
+  }
+
+  for (int i = 0; i < (chunkSize + chunk - 1) / chunk; i++) {
+#pragma HLS loop_tripcount min = 1250 max = 1250
+    int offset = (i * chunk) * numFeaturesV;
+    int rows = (chunkSize - i * chunk < chunk) ? chunkSize - i * chunk : chunk;
+
+    for (int c = 0; c < chunk; c++) {
+#pragma HLS unroll
+      maximum[c] = -INFINITY;
+      sum[c] = 0.0f;
+
+      for (int t = 0; t < topKMax; t++) {
+        topScore[c][t] = -INFINITY;
+        topClass[c][t] = -1;
+      }
+    }
+    CYCLES(1, 1, 1);
+
+    // A short pass reads only its rows, the others are scored but not written
+    for (int cj = 0, c = 0, j = 0; cj < rows * numFeaturesV; cj++, j++) {
+#pragma HLS loop_tripcount min = 784 max = 784
+#pragma HLS pipeline II = 1
+      if (j == numFeaturesV) {
+        j = 0;
+        c++;
+      }
+      features[c][j] = _features[offset + cj];
+    }
+    CYCLES(rows * numFeaturesV, 1, LATENCY_AXI);
+
+    for (int k = 0; k < numClasses; k++) {
+#pragma HLS loop_tripcount min = 10 max = 10
+#pragma HLS pipeline II = 1
+      for (int c = 0; c < chunk; c++) {
+        numerator[k][c * vectorSize] = logf(priors[k]);
+
+        for (int t = 1; t < vectorSize; t++) {
+          numerator[k][c * vectorSize + t] = 0.0f;
+        }
+      }
+    }
+    CYCLES(numClasses, 1, LATENCY_FLOG);
+
+    for (int j = 0; j < numFeaturesV; j++) {
+#pragma HLS loop_tripcount min = 98 max = 98
+      for (int k = 0; k < numClassesMin; k++) {
+#pragma HLS loop_tripcount min = 13 max = 13
+#pragma HLS pipeline II = 1
+        for (int c = 0; c < chunk; c++) {
+          for (int t = 0; t < vectorSize; t++) {
+            converter0.asInt = features[c][j].range((t + 1) * 32 - 1, t * 32);
+            converter1.asInt = means[k][j].range((t + 1) * 32 - 1, t * 32);
+            converter2.asInt = variances[k][j].range((t + 1) * 32 - 1, t * 32);
+
+            float dPiVariances = d_Pi * (converter2.asFloat + epsilon);
+            float firstGroup = dPiVariances ? 0.5f * logf(dPiVariances) : 0;
+
+            float difSquared =
+                (float)(converter0.asFloat - converter1.asFloat) *
+                (converter0.asFloat - converter1.asFloat);
+            float variancesD = 2.0f * (converter2.asFloat + epsilon);
+            float secondGroup = variancesD ? difSquared / variancesD : 0;
+
+            numerator[k][c * vectorSize + t] -= firstGroup + secondGroup;
+          }
+        }
+      }
+      CYCLES(numClassesMin, 1,
+             LATENCY_FADD + LATENCY_FMUL + LATENCY_FLOG + LATENCY_FMUL +
+                 2 * LATENCY_FADD);
+    }
+
+    for (int k = 0; k < numClasses; k++) {
+#pragma HLS loop_tripcount min = 10 max = 10
+      for (int c = 0; c < chunk; c++) {
+#pragma HLS loop_tripcount min = 8 max = 8
+#pragma HLS pipeline II = 1
+        float adder[vectorSize];
+#pragma HLS array_partition variable = adder complete
+
+        for (int t = 0; t < vectorSize; t++) {
+          adder[t] = numerator[k][c * vectorSize + t];
+        }
+
+        // Pairwise adder tree, log2(vectorSize) levels deep
+        for (int width = vectorSize / 2; width > 0; width /= 2) {
+          for (int t = 0; t < width; t++) {
+            adder[t] = adder[2 * t] + adder[2 * t + 1];
+          }
+        }
+
+        float result = adder[0];
+
+        // Running log-sum-exp, rescaled whenever the maximum moves
+        if (result == -INFINITY) {
+          // A class with a zero prior adds nothing, and -inf - -inf is NaN
+        } else if (result > maximum[c]) {
+          sum[c] = sum[c] * expf(maximum[c] - result) + 1.0f;
+          maximum[c] = result;
+        } else {
+          sum[c] += expf(result - maximum[c]);
+        }
+
+        // Shift-register insertion: every position compares against the
+        // new score at once, ties keep the lower class first. Empty
+        // positions (class -1) take any score, -inf included.
+        for (int t = topKMax - 1; t >= 0; t--) {
+          if (result > topScore[c][t] || topClass[c][t] < 0) {
+            if (t > 0 && (result > topScore[c][t - 1] || topClass[c][t - 1] < 0)) {
+              topScore[c][t] = topScore[c][t - 1];
+              topClass[c][t] = topClass[c][t - 1];
+            } else {
+              topScore[c][t] = result;
+              topClass[c][t] = k;
+            }
+          }
+        }
+      }
+      CYCLES(chunk, 1, adderLevels(vectorSize) * LATENCY_FADD + 2 * LATENCY_FADD + 2);
+    }
+
+    for (int c = 0; c < rows; c++) {
+#pragma HLS loop_tripcount min = 8 max = 8
+      float normalizer = maximum[c] + logf(sum[c]);
+
+      for (int t = 0; t < topK; t++) {
+#pragma HLS loop_tripcount min = 5 max = 5
+#pragma HLS pipeline II = 1
+        _classes[(i * chunk + c) * topK + t] = topClass[c][t];
+        _logProbabilities[(i * chunk + c) * topK + t] =
+            topScore[c][t] - normalizer;
+      }
+      CYCLES(topK, 1, LATENCY_FLOG + LATENCY_FADD);
+    }
+  }
+}
+
+#endif // CLASSIFIERTOPK_H
@@ -0,0 +1,46 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef CYCLES_H
+#define CYCLES_H
+
+/**
+* Cycle accounting for C simulation of the kernels.
+*
+* Every pipelined loop adds (iterations - 1) * II + depth to kernelCycles
+* after it runs, and loops that are not pipelined are charged through the
+* pipelined loops they contain. Trip counts and initiation intervals are
+* exact; depths are sums of the operator latencies below, estimated for
+* 250MHz, so the counts compare kernel variants rather than replace
+* co-simulation. Synthesis sees empty macros.
+*/
+#ifdef __SYNTHESIS__
+#define CYCLES(iterations, ii, depth)
+#else
+extern unsigned long long kernelCycles;
+#define CYCLES(iterations, ii, depth)                                          \
+  kernelCycles += ((iterations) > 0)                                           \
+                      ? (unsigned long long)((iterations) - 1) * (ii) + (depth) \
+                      : 0
+#endif
+
+#define LATENCY_AXI 64 // First beat of an AXI read burst
+#define LATENCY_FADD 7
+#define LATENCY_FMUL 4
+#define LATENCY_FDIV 16
+#define LATENCY_FLOG 22
+
+#endif // CYCLES_H
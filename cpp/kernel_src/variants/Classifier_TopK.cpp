@@ -0,0 +1,72 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "../ClassifierTopK.h"
+
+// Shape of the kernel, set per build like Classifier.cpp
+#ifndef KERNEL_NAME
+#define KERNEL_NAME Classifier_TopK
+#endif
+#ifndef NUM_CLASSES_MAX
+#define NUM_CLASSES_MAX 64
+#endif
+#ifndef NUM_FEATURES_MAX
+#define NUM_FEATURES_MAX 4096
+#endif
+#ifndef VECTOR_SIZE
+#define VECTOR_SIZE 8
+#endif
+#ifndef CHUNK
+#define CHUNK 8
+#endif
+#ifndef TOP_K_MAX
+#define TOP_K_MAX 8
+#endif
+
+typedef ap_int<32 * VECTOR_SIZE> floatV;
+
+// topK classes per example, clamped to TOP_K_MAX: _classes and
+// _logProbabilities hold chunkSize * min(topK, TOP_K_MAX) values
+extern "C" {
+void KERNEL_NAME(floatV *_features, floatV *_means, floatV *_variances,
+                 float *_priors, int *_classes, float *_logProbabilities,
+                 float epsilon, int numClasses, int numFeatures,
+                 int chunkSize, int topK) {
+#pragma HLS INTERFACE m_axi port = _features offset = slave bundle = gmem0
+#pragma HLS INTERFACE m_axi port = _means offset = slave bundle = gmem1
+#pragma HLS INTERFACE m_axi port = _variances offset = slave bundle = gmem2
+#pragma HLS INTERFACE m_axi port = _priors offset = slave bundle = gmem3
+#pragma HLS INTERFACE m_axi port = _classes offset = slave bundle = gmem4
+#pragma HLS INTERFACE m_axi port = _logProbabilities offset = slave bundle = gmem5
+#pragma HLS INTERFACE s_axilite port = _features bundle = control
+#pragma HLS INTERFACE s_axilite port = _means bundle = control
+#pragma HLS INTERFACE s_axilite port = _variances bundle = control
+#pragma HLS INTERFACE s_axilite port = _priors bundle = control
+#pragma HLS INTERFACE s_axilite port = _classes bundle = control
+#pragma HLS INTERFACE s_axilite port = _logProbabilities bundle = control
+#pragma HLS INTERFACE s_axilite port = epsilon bundle = control
+#pragma HLS INTERFACE s_axilite port = numClasses bundle = control
+#pragma HLS INTERFACE s_axilite port = numFeatures bundle = control
+#pragma HLS INTERFACE s_axilite port = chunkSize bundle = control
+#pragma HLS INTERFACE s_axilite port = topK bundle = control
+#pragma HLS INTERFACE s_axilite port = return bundle = control
+
+  classifierTopK<NUM_CLASSES_MAX, NUM_FEATURES_MAX, VECTOR_SIZE, CHUNK,
+                 TOP_K_MAX>(_features, _means, _variances, _priors, _classes,
+                            _logProbabilities, epsilon, numClasses,
+                            numFeatures, chunkSize, topK);
+}
+}
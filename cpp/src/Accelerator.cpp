@@ -0,0 +1,100 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Accelerator.h"
+
+#define VECTORIZATION 8 // Vectorization of features in HW
+
+std::future<void> Coral::classify(inaccel::vector<float>::iterator featuresBegin, inaccel::vector<float>::iterator featuresEnd,
+		inaccel::vector<float> &means, inaccel::vector<float> &variances, inaccel::vector<float> &priors,
+		inaccel::vector<int>::iterator predictionsBegin, inaccel::vector<int>::iterator predictionsEnd,
+		float epsilon, int numClasses, int numFeatures, int chunkSize) {
+	inaccel::request nbc("com.inaccel.ml.NaiveBayes.Classifier");
+
+	nbc.arg<float>(featuresBegin, featuresEnd)
+		.arg(means)
+		.arg(variances)
+		.arg(priors)
+		.arg<int>(predictionsBegin, predictionsEnd)
+		.arg(epsilon)
+		.arg(numClasses)
+		.arg(numFeatures)
+		.arg(chunkSize);
+
+	return inaccel::submit(nbc);
+}
+
+std::future<void> Emulator::classify(inaccel::vector<float>::iterator featuresBegin, inaccel::vector<float>::iterator featuresEnd,
+		inaccel::vector<float> &means, inaccel::vector<float> &variances, inaccel::vector<float> &priors,
+		inaccel::vector<int>::iterator predictionsBegin, inaccel::vector<int>::iterator predictionsEnd,
+		float epsilon, int numClasses, int numFeatures, int chunkSize) {
+	// Like the kernel, the padded features take part in the sums
+	int numFeaturesPadded = (numFeatures + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1));
+	size_t model = (size_t)numClasses * numFeaturesPadded;
+
+	// The kernel would read and write past a buffer that is too short
+	if (featuresEnd - featuresBegin < (ptrdiff_t)chunkSize * numFeaturesPadded || predictionsEnd - predictionsBegin < chunkSize
+			|| means.size() < model || variances.size() < model || priors.size() < (size_t)numClasses) {
+		throw std::runtime_error("Request buffers smaller than " + std::to_string(chunkSize) + " examples of " + std::to_string(numClasses) + " classes x " + std::to_string(numFeatures) + " features");
+	}
+
+	const float *x = &*featuresBegin;
+	const float *m = means.data();
+	const float *v = variances.data();
+	const float *p = priors.data();
+	int *prediction = &*predictionsBegin;
+
+	return std::async(std::launch::async, [=] {
+		float d_Pi = 2 * M_PI;
+
+		std::vector<float> firstGroup(model);
+		std::vector<float> variancesD(model);
+
+		for (size_t kj = 0; kj < model; kj++) {
+			float dPiVariances = d_Pi * (v[kj] + epsilon);
+			firstGroup[kj] = dPiVariances ? 0.5f * logf(dPiVariances) : 0;
+			variancesD[kj] = 2.0f * (v[kj] + epsilon);
+		}
+
+		#pragma omp parallel for
+		for (int i = 0; i < chunkSize; i++) {
+			const float *features = x + (size_t)i * numFeaturesPadded;
+			float max_likelihood = -INFINITY;
+
+			for (int k = 0; k < numClasses; k++) {
+				float numerator = logf(p[k]);
+
+				for (int j = 0; j < numFeaturesPadded; j++) {
+					int kj = k * numFeaturesPadded + j;
+					float difSquared = (features[j] - m[kj]) * (features[j] - m[kj]);
+					float secondGroup = variancesD[kj] ? difSquared / variancesD[kj] : 0;
+
+					numerator -= firstGroup[kj] + secondGroup;
+				}
+
+				if (numerator > max_likelihood) {
+					max_likelihood = numerator;
+					prediction[i] = k;
+				}
+			}
+		}
+	});
+}
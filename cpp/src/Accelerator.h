@@ -0,0 +1,60 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef ACCELERATOR_H
+#define ACCELERATOR_H
+
+#include <future>
+#include <inaccel/coral>
+
+/**
+* Backend for com.inaccel.ml.NaiveBayes.Classifier requests.
+*
+* A request scores chunkSize padded examples (a multiple of 8) against the
+* model and writes one prediction per example. The buffers must stay alive
+* until the returned future is ready.
+*/
+class Accelerator {
+public:
+	virtual ~Accelerator() {}
+
+	virtual std::future<void> classify(inaccel::vector<float>::iterator featuresBegin, inaccel::vector<float>::iterator featuresEnd,
+			inaccel::vector<float> &means, inaccel::vector<float> &variances, inaccel::vector<float> &priors,
+			inaccel::vector<int>::iterator predictionsBegin, inaccel::vector<int>::iterator predictionsEnd,
+			float epsilon, int numClasses, int numFeatures, int chunkSize) = 0;
+};
+
+// Submits the requests to the FPGAs through InAccel Coral
+class Coral : public Accelerator {
+public:
+	std::future<void> classify(inaccel::vector<float>::iterator featuresBegin, inaccel::vector<float>::iterator featuresEnd,
+			inaccel::vector<float> &means, inaccel::vector<float> &variances, inaccel::vector<float> &priors,
+			inaccel::vector<int>::iterator predictionsBegin, inaccel::vector<int>::iterator predictionsEnd,
+			float epsilon, int numClasses, int numFeatures, int chunkSize);
+};
+
+// CPU stand-in that computes what the Classifier kernel computes, for
+// testing the host side on machines without an FPGA. Throws
+// std::runtime_error if a buffer is shorter than the request
+class Emulator : public Accelerator {
+public:
+	std::future<void> classify(inaccel::vector<float>::iterator featuresBegin, inaccel::vector<float>::iterator featuresEnd,
+			inaccel::vector<float> &means, inaccel::vector<float> &variances, inaccel::vector<float> &priors,
+			inaccel::vector<int>::iterator predictionsBegin, inaccel::vector<int>::iterator predictionsEnd,
+			float epsilon, int numClasses, int numFeatures, int chunkSize);
+};
+
+#endif // ACCELERATOR_H
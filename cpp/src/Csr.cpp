@@ -0,0 +1,131 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "Csr.h"
+#include "Reader.h"
+
+#define VECTORIZATION 8 // Padding of the dense rows from Reader
+#define DENSE_BYTES (64 << 20) // Dense chunk size when converting from Reader
+
+Csr::Csr(int numFeatures): numFeatures(numFeatures), offsets(1, 0) {}
+
+int Csr::rows() const {
+	return labels.size();
+}
+
+void Csr::clear() {
+	labels.clear();
+	offsets.assign(1, 0);
+	indices.clear();
+	values.clear();
+}
+
+void Csr::append(int label, const float *x) {
+	for (int j = 0; j < numFeatures; j++) {
+		if (x[j] != 0.0f) {
+			indices.push_back(j);
+			values.push_back(x[j]);
+		}
+	}
+
+	labels.push_back(label);
+	offsets.push_back(indices.size());
+}
+
+// LIBSVM lines have a ':' in their second token, dense CSV lines do not
+static bool libsvm(std::string filename) {
+	FILE *file = fopen(filename.c_str(), "r");
+	if (!file) throw std::runtime_error("Cannot open " + filename);
+
+	char line[256];
+	bool detected = fgets(line, sizeof(line), file) && strchr(line, ':') && !strchr(line, ',');
+	fclose(file);
+
+	return detected;
+}
+
+void Csr::read(std::string filename, int numExamples) {
+	clear();
+
+	if (!libsvm(filename)) {
+		int numFeaturesPadded = (numFeatures + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1));
+		int chunkRows = std::max(1, (int)(DENSE_BYTES / (numFeaturesPadded * sizeof(float))));
+
+		Reader reader(numFeatures, numFeaturesPadded);
+		reader.open(filename);
+
+		std::vector<int> chunkLabels(chunkRows);
+		std::vector<float> chunkFeatures((size_t)chunkRows * numFeaturesPadded);
+
+		while (rows() < numExamples) {
+			int n = reader.read(std::min(chunkRows, numExamples - rows()), chunkLabels.data(), chunkFeatures.data());
+			if (!n) break;
+
+			for (int i = 0; i < n; i++) {
+				append(chunkLabels[i], &chunkFeatures[(size_t)i * numFeaturesPadded]);
+			}
+		}
+
+		return;
+	}
+
+	FILE *file = fopen(filename.c_str(), "r");
+	if (!file) throw std::runtime_error("Cannot open " + filename);
+
+	char *line = nullptr;
+	size_t capacity = 0;
+
+	while (rows() < numExamples && getline(&line, &capacity, file) > 0) {
+		char *p = line;
+		char *end;
+		int label = strtol(p, &end, 10);
+		if (end == p) {
+			free(line);
+			fclose(file);
+			throw std::runtime_error("Invalid label in " + filename);
+		}
+		p = end;
+
+		for (;;) {
+			long index = strtol(p, &end, 10);
+			if (end == p || *end != ':') break;
+
+			float value = strtof(end + 1, &p);
+			if (index < 1 || index > numFeatures) {
+				free(line);
+				fclose(file);
+				throw std::runtime_error("Feature index out of range in " + filename);
+			}
+
+			if (value != 0.0f) {
+				indices.push_back(index - 1);
+				values.push_back(value);
+			}
+		}
+
+		labels.push_back(label);
+		offsets.push_back(indices.size());
+	}
+
+	free(line);
+	fclose(file);
+}
@@ -0,0 +1,53 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef CSR_H
+#define CSR_H
+
+#include <string>
+#include <vector>
+
+/**
+* Examples in compressed sparse row form: the nonzero features of example i
+* are indices[offsets[i] .. offsets[i + 1]) with their values, in
+* increasing index order. Memory and work scale with the nonzeros, so the
+* number of features is not bounded like the dense layout.
+*/
+class Csr {
+public:
+	int numFeatures;
+
+	std::vector<int> labels;
+	std::vector<long long> offsets;
+	std::vector<int> indices;
+	std::vector<float> values;
+
+	Csr(int numFeatures);
+
+	int rows() const;
+
+	void clear();
+
+	// Appends an example given as numFeatures dense floats
+	void append(int label, const float *x);
+
+	// Reads up to numExamples examples from a LIBSVM file ("label index:value
+	// ...", 1-based increasing indices), or from any file Reader accepts.
+	// Throws std::runtime_error if the file cannot be read.
+	void read(std::string filename, int numExamples);
+};
+
+#endif // CSR_H
@@ -0,0 +1,266 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <omp.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Csv.h"
+
+static const double powers[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool digit(char c) {
+	return (unsigned)(c - '0') < 10;
+}
+
+static inline const char *parse_int(const char *p, const char *e, int *value) {
+	bool negative = (p < e && *p == '-');
+	if (p < e && (*p == '-' || *p == '+')) p++;
+
+	int result = 0;
+	for (; p < e && digit(*p); p++) {
+		result = result * 10 + (*p - '0');
+	}
+
+	*value = negative ? -result : result;
+	return p;
+}
+
+// Whether a double is halfway between two adjacent floats, in the normal
+// float range: its 29 bits below the float mantissa are exactly 1000...0
+static inline bool halfway(double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	return (bits & ((1ull << 29) - 1)) == (1ull << 28);
+}
+
+// from_chars-style decimal parser: the significand is gathered in an integer
+// and scaled by an exact power of ten, which is the correctly rounded double
+// whenever it has at most 53 bits and |exponent| <= 22. Rounding that double
+// to float gives the correctly rounded float unless the double is exactly
+// halfway between two floats, as no other halfway point can lie between the
+// double and the decimal value. Anything else goes through strtof on the
+// whole token, so the result always equals strtof's.
+static inline const char *parse_float(const char *p, const char *e, float *value) {
+	const char *start = p;
+
+	bool negative = (p < e && *p == '-');
+	if (p < e && (*p == '-' || *p == '+')) p++;
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+
+	for (; p < e && digit(*p); p++) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa) digits++;
+		} else {
+			exponent++;
+		}
+	}
+
+	if (p < e && *p == '.') {
+		for (p++; p < e && digit(*p); p++) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) digits++;
+				exponent--;
+			}
+		}
+	}
+
+	if (p < e && (*p == 'e' || *p == 'E')) {
+		int power;
+		p = parse_int(p + 1, e, &power);
+		exponent += power;
+	}
+
+	// Past 19 digits the mantissa is above 2^53, so dropped digits never
+	// take the fast path
+	if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+		double result = (exponent < 0) ? mantissa / powers[-exponent] : mantissa * powers[exponent];
+
+		if (!halfway(result)) {
+			*value = negative ? -(float)result : (float)result;
+			return p;
+		}
+	}
+
+	// The mapped file is not NUL terminated
+	char buffer[64];
+	size_t size = p - start;
+	std::string token;
+	const char *text = buffer;
+
+	if (size < sizeof(buffer)) {
+		memcpy(buffer, start, size);
+		buffer[size] = '\0';
+	} else {
+		token.assign(start, size);
+		text = token.c_str();
+	}
+
+	*value = strtof(text, nullptr);
+	return p;
+}
+
+Csv::Csv(): begin(nullptr), end(nullptr), position(nullptr), length(0), bytesPerRow(0) {}
+
+Csv::~Csv() {
+	close();
+}
+
+void Csv::open(std::string filename) {
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Cannot open " + filename);
+
+	struct stat st;
+	if (fstat(fd, &st)) {
+		::close(fd);
+		throw std::runtime_error("Cannot open " + filename);
+	}
+
+	if (st.st_size) {
+		void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED) {
+			::close(fd);
+			throw std::runtime_error("Cannot map " + filename);
+		}
+
+		madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+		begin = (const char *) mapped;
+		length = st.st_size;
+	}
+	::close(fd);
+
+	end = begin + length;
+	rewind();
+}
+
+void Csv::close() {
+	if (begin) munmap((void *) begin, length);
+
+	begin = end = position = nullptr;
+	length = 0;
+}
+
+void Csv::rewind() {
+	position = begin;
+
+	const char *newline = begin ? (const char *) memchr(begin, '\n', length) : nullptr;
+	bytesPerRow = newline ? (newline - begin + 1) : length;
+}
+
+// Whether a line is empty, as a blank line in the middle of a file is
+static inline bool blank(const char *p) {
+	return *p == '\n' || *p == '\r';
+}
+
+// Collects the starts of the next rows + 1 non-empty lines, scanning windows
+// sized from the bytes per row seen so far, each split across the threads
+void Csv::index(int rows) {
+	starts.clear();
+	while (position < end && blank(position)) position++;
+	if (position >= end) return;
+
+	starts.push_back(position);
+
+	std::vector<std::vector<const char *>> found;
+
+	const char *scanned = position;
+	while ((int)starts.size() <= rows && scanned < end) {
+		size_t window = std::min((size_t)(end - scanned), (size_t)(bytesPerRow * (rows + 1 - starts.size()) * 1.1) + 4096);
+
+		#pragma omp parallel
+		{
+			int t = omp_get_thread_num();
+			int n = omp_get_num_threads();
+
+			// One slot per thread of the team, which can be smaller than
+			// omp_get_max_threads
+			#pragma omp single
+			found.resize(n);
+
+			const char *p = scanned + window * t / n;
+			const char *limit = scanned + window * (t + 1) / n;
+
+			found[t].clear();
+			while (p < limit && (p = (const char *) memchr(p, '\n', limit - p))) {
+				if (++p < end && !blank(p)) found[t].push_back(p);
+			}
+		}
+
+		for (size_t t = 0; t < found.size(); t++) {
+			starts.insert(starts.end(), found[t].begin(), found[t].end());
+		}
+
+		scanned += window;
+	}
+
+	if ((int)starts.size() > rows + 1) starts.resize(rows + 1);
+}
+
+int Csv::read(int rows, int numFeatures, int numFeaturesPadded, int *labels, float *features) {
+	index(rows);
+
+	int count = std::min((int)starts.size(), rows);
+	if (!count) return 0;
+
+	const char *next = ((int)starts.size() > count) ? starts[count] : end;
+
+	#pragma omp parallel for schedule(dynamic, 256)
+	for (int i = 0; i < count; i++) {
+		const char *p = starts[i];
+		const char *e = (i + 1 < (int)starts.size()) ? starts[i + 1] : end;
+		float *row = features + (size_t)i * numFeaturesPadded;
+
+		p = parse_int(p, e, &labels[i]);
+
+		int j = 0;
+		for (; j < numFeatures && p < e && *p == ','; j++) {
+			p = parse_float(p + 1, e, &row[j]);
+		}
+
+		for (; j < numFeaturesPadded; j++) {
+			row[j] = 0.0f;
+		}
+	}
+
+	bytesPerRow = (double)(next - position) / count;
+	position = next;
+
+	// Parsed text is not needed again, keep the mapping's resident set bounded
+	size_t consumed = (position - begin) & ~(size_t)(sysconf(_SC_PAGESIZE) - 1);
+	if (consumed) madvise((void *) begin, consumed, MADV_DONTNEED);
+
+	return count;
+}
@@ -0,0 +1,63 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef CSV_H
+#define CSV_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+* Parallel reader for "label,feature0,feature1,..." CSV files.
+*
+* The file is memory-mapped and read in batches of lines. For each batch the
+* byte range is split across the OpenMP threads, which find the line starts
+* with memchr and then parse the lines independently, writing each example
+* straight into its padded row of the caller's buffer.
+*/
+class Csv {
+private:
+	const char *begin;
+	const char *end;
+	const char *position;
+	size_t length;
+
+	double bytesPerRow;
+
+	std::vector<const char *> starts;
+
+	void index(int rows);
+
+public:
+	Csv();
+
+	~Csv();
+
+	// Throws std::runtime_error if the file cannot be opened
+	void open(std::string filename);
+
+	void close();
+
+	void rewind();
+
+	// Parses up to rows examples into labels[rows] and features[rows][numFeaturesPadded]
+	// and returns how many were read, 0 at the end of the file; empty lines
+	// are skipped
+	int read(int rows, int numFeatures, int numFeaturesPadded, int *labels, float *features);
+};
+
+#endif // CSV_H
@@ -0,0 +1,139 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Dataset.h"
+
+static_assert(sizeof(DatasetHeader) == 64, "DatasetHeader must be 64 bytes");
+
+// Whether count elements of size bytes from offset lie within the file,
+// without overflowing on a corrupt header
+static bool fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t fileSize) {
+	if (offset > fileSize || offset % sizeof(float)) return false;
+	return !size || count <= (fileSize - offset) / size;
+}
+
+// Every offset and count of the header checked against the file, so a
+// truncated or corrupt file cannot send a read past the mapping
+static bool valid(const DatasetHeader *header, uint64_t fileSize) {
+	if (memcmp(header->magic, DATASET_MAGIC, sizeof(header->magic)) || header->version != DATASET_VERSION) return false;
+	if (header->numExamples > INT_MAX || header->numFeaturesPadded > INT_MAX || !header->numFeatures || header->numFeaturesPadded < header->numFeatures) return false;
+	if (header->labelsOffset < sizeof(DatasetHeader) || !fits(header->labelsOffset, header->numExamples, sizeof(int), fileSize)) return false;
+	if (header->featuresOffset < header->labelsOffset + header->numExamples * sizeof(int)) return false;
+
+	return fits(header->featuresOffset, header->numExamples, (uint64_t)header->numFeaturesPadded * sizeof(float), fileSize);
+}
+
+Dataset::Dataset(): address(nullptr), length(0), numExamples(0), numFeatures(0), numFeaturesPadded(0), labels(nullptr), features(nullptr) {}
+
+Dataset::~Dataset() {
+	close();
+}
+
+void Dataset::open(std::string filename) {
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Cannot open dataset " + filename);
+
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(DatasetHeader)) {
+		::close(fd);
+		throw std::runtime_error("Invalid dataset " + filename);
+	}
+
+	void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED) throw std::runtime_error("Cannot map dataset " + filename);
+
+	const DatasetHeader *header = (const DatasetHeader *) mapped;
+	if (!valid(header, st.st_size)) {
+		munmap(mapped, st.st_size);
+		throw std::runtime_error("Invalid dataset " + filename);
+	}
+
+	madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+	address = mapped;
+	length = st.st_size;
+
+	numExamples = header->numExamples;
+	numFeatures = header->numFeatures;
+	numFeaturesPadded = header->numFeaturesPadded;
+	labels = (const int *) ((const char *) mapped + header->labelsOffset);
+	features = (const float *) ((const char *) mapped + header->featuresOffset);
+}
+
+void Dataset::close() {
+	if (address) munmap(address, length);
+
+	address = nullptr;
+	length = 0;
+	labels = nullptr;
+	features = nullptr;
+}
+
+void Dataset::release(int examples) {
+	const char *consumed = (const char *) (features + (size_t)examples * numFeaturesPadded);
+	size_t size = (consumed - (const char *) address) & ~(size_t)(DATASET_ALIGNMENT - 1);
+
+	if (size) madvise(address, size, MADV_DONTNEED);
+}
+
+bool Dataset::detect(std::string filename) {
+	char magic[8];
+
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file) return false;
+
+	bool detected = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && !memcmp(magic, DATASET_MAGIC, sizeof(magic));
+	fclose(file);
+
+	return detected;
+}
+
+void Dataset::write(std::string filename, const int *labels, const float *features, int numExamples, int numFeatures, int numFeaturesPadded) {
+	DatasetHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+	header.version = DATASET_VERSION;
+	header.numExamples = numExamples;
+	header.numFeatures = numFeatures;
+	header.numFeaturesPadded = numFeaturesPadded;
+	header.labelsOffset = sizeof(header);
+	header.featuresOffset = (header.labelsOffset + numExamples * sizeof(int) + (DATASET_ALIGNMENT - 1)) & ~(uint64_t)(DATASET_ALIGNMENT - 1);
+
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file) throw std::runtime_error("Cannot create dataset " + filename);
+
+	std::vector<char> padding(header.featuresOffset - header.labelsOffset - numExamples * sizeof(int), 0);
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(labels, sizeof(int), numExamples, file) == (size_t)numExamples
+		&& fwrite(padding.data(), 1, padding.size(), file) == padding.size()
+		&& fwrite(features, sizeof(float), (size_t)numExamples * numFeaturesPadded, file) == (size_t)numExamples * numFeaturesPadded;
+
+	if (fclose(file) || !written) throw std::runtime_error("Cannot write dataset " + filename);
+}
@@ -0,0 +1,80 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define DATASET_MAGIC "NBDATA\0\0"
+#define DATASET_VERSION 1
+#define DATASET_ALIGNMENT 4096 // Features start on a page boundary
+
+/**
+* Binary dataset file, little-endian:
+*   header   | DatasetHeader, 64 bytes
+*   labels   | int32[numExamples]
+*   padding  | up to featuresOffset
+*   features | float[numExamples][numFeaturesPadded], zero padded
+*
+* The file is memory-mapped read-only, so opening it costs no per-value work
+* and the features are used in place by the CPU paths.
+*/
+struct DatasetHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numFeatures;
+	uint64_t numExamples;
+	uint32_t numFeaturesPadded;
+	uint32_t reserved;
+	uint64_t labelsOffset;
+	uint64_t featuresOffset;
+	uint64_t unused[2];
+};
+
+class Dataset {
+private:
+	void *address;
+	size_t length;
+
+public:
+	int numExamples;
+	int numFeatures;
+	int numFeaturesPadded;
+
+	const int *labels;
+	const float *features;
+
+	Dataset();
+
+	~Dataset();
+
+	// Throws std::runtime_error if the file is missing or not a valid dataset
+	void open(std::string filename);
+
+	void close();
+
+	// Drops the mapped pages of the first examples once they are consumed
+	void release(int examples);
+
+	static bool detect(std::string filename);
+
+	static void write(std::string filename, const int *labels, const float *features, int numExamples, int numFeatures, int numFeaturesPadded);
+};
+
+#endif // DATASET_H
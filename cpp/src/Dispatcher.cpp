@@ -0,0 +1,107 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "Dispatcher.h"
+
+#define DECAY 0.8 // Weight kept by past observations on every new one
+
+#define PRIOR_ROW_NS 1000.0 // CPU time per example before any measurement
+#define PRIOR_REQUEST_NS 1e6 // Accelerator time per request before any measurement
+#define PRIOR_BYTE_NS 0.5 // Accelerator time per byte before any measurement
+#define PRIOR_BYTES 64e6 // Size of the prior per-byte pseudo-observation
+
+Dispatcher::Dispatcher(): cpuRowNs(PRIOR_ROW_NS), srr(0), srb(0), sbb(0), srt(0), sbt(0) {
+	// One request moving nothing, and a transfer without request overhead
+	observeHW(1, 0, PRIOR_REQUEST_NS);
+	observeHW(0, PRIOR_BYTES, PRIOR_BYTES * PRIOR_BYTE_NS);
+}
+
+void Dispatcher::observeSW(int rows, double ns) {
+	if (rows <= 0) return;
+
+	cpuRowNs = DECAY * cpuRowNs + (1 - DECAY) * (ns / rows);
+}
+
+void Dispatcher::observeHW(int requests, double bytes, double ns) {
+	srr = DECAY * srr + (double)requests * requests;
+	srb = DECAY * srb + requests * bytes;
+	sbb = DECAY * sbb + bytes * bytes;
+	srt = DECAY * srt + requests * ns;
+	sbt = DECAY * sbt + bytes * ns;
+}
+
+double Dispatcher::costSW(int rows) const {
+	return cpuRowNs * rows;
+}
+
+double Dispatcher::costHW(int requests, double bytes) const {
+	double perRequest = PRIOR_REQUEST_NS;
+	double perByte = PRIOR_BYTE_NS;
+
+	// Normal equations of the 2x2 regression, kept at the priors while the
+	// observations cannot tell the two terms apart
+	double det = srr * sbb - srb * srb;
+	if (det > 1e-9 * srr * sbb) {
+		perRequest = std::max((srt * sbb - sbt * srb) / det, 0.0);
+		perByte = std::max((sbt * srr - srt * srb) / det, 0.0);
+	}
+
+	return perRequest * requests + perByte * bytes;
+}
+
+int Dispatcher::requests(int rows, int maxRequests, int requestRows) {
+	return std::max(1, std::min(maxRequests, (rows + requestRows - 1) / requestRows));
+}
+
+int Dispatcher::split(int rows, double rowBytes, double requestBytes, int maxRequests, int requestRows, int granularity) const {
+	if (rows <= 0) return 0;
+
+	int best = 0;
+	double bestCost = costSW(rows);
+
+	int r = requests(rows, maxRequests, requestRows);
+	double all = costHW(r, rows * rowBytes + r * requestBytes);
+	if (all < bestCost) {
+		best = rows;
+		bestCost = all;
+	}
+
+	// Balance costSW(rows - h) = costHW(r, h * rowBytes + r * requestBytes),
+	// solved again once since the number of requests depends on h
+	double perRow = costHW(0, rowBytes);
+
+	int h = rows;
+	for (int iteration = 0; iteration < 2; iteration++) {
+		r = requests(h, maxRequests, requestRows);
+
+		double balanced = (costSW(rows) - costHW(r, r * requestBytes)) / (costSW(1) + perRow);
+		h = std::min((double)rows, std::max(0.0, balanced));
+		h -= h % granularity;
+		if (!h) break;
+
+		r = requests(h, maxRequests, requestRows);
+		double makespan = std::max(costSW(rows - h), costHW(r, h * rowBytes + r * requestBytes));
+		if (makespan < bestCost) {
+			best = h;
+			bestCost = makespan;
+		}
+	}
+
+	return best;
+}
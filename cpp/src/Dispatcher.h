@@ -0,0 +1,57 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+/**
+* Online cost model that routes a batch between the CPU and the accelerator.
+*
+* The CPU costs a fixed time per example. An accelerator call costs
+*   perRequest * requests + perByte * bytes
+* fitted by exponentially weighted least squares on the measured timings,
+* starting from two prior pseudo-observations that fade out as real ones
+* arrive. A batch is split so that both sides are expected to finish at the
+* same time, or sent whole to the faster side.
+*/
+class Dispatcher {
+private:
+	double cpuRowNs;
+
+	// Weighted sums of the accelerator regression ns = a * requests + b * bytes
+	double srr, srb, sbb, srt, sbt;
+
+public:
+	Dispatcher();
+
+	void observeSW(int rows, double ns);
+
+	void observeHW(int requests, double bytes, double ns);
+
+	double costSW(int rows) const;
+
+	double costHW(int requests, double bytes) const;
+
+	// Examples of a rows batch to route to the accelerator: 0 keeps them all
+	// on the CPU, otherwise a multiple of granularity or rows. Accelerator
+	// calls move rowBytes per example plus requestBytes per request, in up to
+	// maxRequests requests of requestRows examples.
+	int split(int rows, double rowBytes, double requestBytes, int maxRequests, int requestRows, int granularity) const;
+
+	static int requests(int rows, int maxRequests, int requestRows);
+};
+
+#endif // DISPATCHER_H
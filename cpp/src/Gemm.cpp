@@ -0,0 +1,254 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <assert.h>
+#include <immintrin.h>
+
+#ifdef NAIVEBAYES_BLAS
+#include <cblas.h>
+#endif
+
+#include "Gemm.h"
+#include "Kernels.h"
+
+#define GEMM_CLASSES_MAX 64 // Max padded classes held in the on-stack result tile
+
+#define MC 32 // Examples per cache block
+#define KC 128 // Features per cache block
+
+typedef void (*micro_t)(const float *, const float *, int, float *, int);
+
+// Packs x^2 and x of MR examples per feature, centered: [feature][x^2 | x][MR]
+static void pack(const float *x, int ldx, const float *centers, int rows, int kc, int mr, float *packed) {
+	int rowsPadded = (rows + mr - 1) / mr * mr;
+
+	for (int ir = 0; ir < rowsPadded; ir += mr) {
+		float *panel = packed + ir * kc * 2;
+
+		for (int j = 0; j < kc; j++) {
+			for (int r = 0; r < mr; r++) {
+				float data = (ir + r < rows) ? x[(ir + r) * ldx + j] - centers[j] : 0.0f;
+				panel[j * 2 * mr + r] = data * data;
+				panel[j * 2 * mr + mr + r] = data;
+			}
+		}
+	}
+}
+
+static void micro_scalar(const float *a, const float *w, int kc, float *c, int ldc) {
+	for (int j = 0; j < kc; j++) {
+		for (int r = 0; r < 4; r++) {
+			float square = a[j * 8 + r];
+			float data = a[j * 8 + 4 + r];
+
+			for (int t = 0; t < 16; t++) {
+				c[r * ldc + t] += square * w[j * 32 + t] + data * w[j * 32 + 16 + t];
+			}
+		}
+	}
+}
+
+// 4 examples x 16 classes: 8 accumulators and 4 weight vectors in 16 ymm registers
+__attribute__((target("avx2,fma")))
+static void micro_avx2(const float *a, const float *w, int kc, float *c, int ldc) {
+	__m256 acc[4][2];
+	for (int r = 0; r < 4; r++) {
+		acc[r][0] = _mm256_loadu_ps(c + r * ldc);
+		acc[r][1] = _mm256_loadu_ps(c + r * ldc + 8);
+	}
+
+	for (int j = 0; j < kc; j++) {
+		__m256 a0 = _mm256_loadu_ps(w + j * 32);
+		__m256 a1 = _mm256_loadu_ps(w + j * 32 + 8);
+		__m256 b0 = _mm256_loadu_ps(w + j * 32 + 16);
+		__m256 b1 = _mm256_loadu_ps(w + j * 32 + 24);
+
+		for (int r = 0; r < 4; r++) {
+			__m256 square = _mm256_broadcast_ss(a + j * 8 + r);
+			__m256 data = _mm256_broadcast_ss(a + j * 8 + 4 + r);
+			acc[r][0] = _mm256_fmadd_ps(square, a0, acc[r][0]);
+			acc[r][1] = _mm256_fmadd_ps(square, a1, acc[r][1]);
+			acc[r][0] = _mm256_fmadd_ps(data, b0, acc[r][0]);
+			acc[r][1] = _mm256_fmadd_ps(data, b1, acc[r][1]);
+		}
+	}
+
+	for (int r = 0; r < 4; r++) {
+		_mm256_storeu_ps(c + r * ldc, acc[r][0]);
+		_mm256_storeu_ps(c + r * ldc + 8, acc[r][1]);
+	}
+}
+
+// 8 examples x 32 classes: 16 accumulators and 4 weight vectors in 32 zmm registers
+__attribute__((target("avx512f")))
+static void micro_avx512(const float *a, const float *w, int kc, float *c, int ldc) {
+	__m512 acc[8][2];
+	for (int r = 0; r < 8; r++) {
+		acc[r][0] = _mm512_loadu_ps(c + r * ldc);
+		acc[r][1] = _mm512_loadu_ps(c + r * ldc + 16);
+	}
+
+	for (int j = 0; j < kc; j++) {
+		__m512 a0 = _mm512_loadu_ps(w + j * 64);
+		__m512 a1 = _mm512_loadu_ps(w + j * 64 + 16);
+		__m512 b0 = _mm512_loadu_ps(w + j * 64 + 32);
+		__m512 b1 = _mm512_loadu_ps(w + j * 64 + 48);
+
+		for (int r = 0; r < 8; r++) {
+			__m512 square = _mm512_set1_ps(a[j * 16 + r]);
+			__m512 data = _mm512_set1_ps(a[j * 16 + 8 + r]);
+			acc[r][0] = _mm512_fmadd_ps(square, a0, acc[r][0]);
+			acc[r][1] = _mm512_fmadd_ps(square, a1, acc[r][1]);
+			acc[r][0] = _mm512_fmadd_ps(data, b0, acc[r][0]);
+			acc[r][1] = _mm512_fmadd_ps(data, b1, acc[r][1]);
+		}
+	}
+
+	for (int r = 0; r < 8; r++) {
+		_mm512_storeu_ps(c + r * ldc, acc[r][0]);
+		_mm512_storeu_ps(c + r * ldc + 16, acc[r][1]);
+	}
+}
+
+// Micro-kernel shape (examples x classes) for the selected instruction set
+static int mr() {
+	return (kernels::isa() == kernels::AVX512) ? 8 : 4;
+}
+
+static int nr() {
+	return (kernels::isa() == kernels::AVX512) ? 32 : 16;
+}
+
+Gemm::Gemm(): numClasses(0), numClassesPadded(0), numFeatures(0), numFeaturesPadded(0) {}
+
+void Gemm::compile(const Model &model) {
+	numClasses = model.numClasses;
+	numFeatures = model.numFeatures;
+	numFeaturesPadded = model.numFeaturesPadded;
+
+	centers.assign(numFeaturesPadded, 0.0f);
+	constants.assign(numClasses, 0.0f);
+
+	for (int j = 0; j < numFeatures; j++) {
+		double center = 0.0;
+		for (int k = 0; k < numClasses; k++) {
+			center += model.means[k * numFeaturesPadded + j];
+		}
+
+		centers[j] = center / numClasses;
+	}
+
+	// Means relative to the centers, [numClasses][numFeaturesPadded]
+	std::vector<float> means(numClasses * numFeaturesPadded, 0.0f);
+
+	for (int k = 0; k < numClasses; k++) {
+		double constant = model.constants[k];
+		for (int j = 0; j < numFeatures; j++) {
+			int index = k * numFeaturesPadded + j;
+			means[index] = model.means[index] - centers[j];
+			constant += (double)model.coefficients[index] * means[index] * means[index];
+		}
+
+		constants[k] = constant;
+	}
+
+#ifdef NAIVEBAYES_BLAS
+	// Two row-major [K x F] operands: x^2 weights then x weights
+	numClassesPadded = numClasses;
+	weights.assign(2 * numClasses * numFeaturesPadded, 0.0f);
+
+	for (int k = 0; k < numClasses; k++) {
+		for (int j = 0; j < numFeatures; j++) {
+			int index = k * numFeaturesPadded + j;
+			weights[index] = model.coefficients[index];
+			weights[numClasses * numFeaturesPadded + index] = -2.0f * model.coefficients[index] * means[index];
+		}
+	}
+#else
+	// Panels of nr() classes: [panel][feature][x^2 weights | x weights][nr()]
+	int n = nr();
+	numClassesPadded = (numClasses + n - 1) / n * n;
+	assert (numClassesPadded <= GEMM_CLASSES_MAX);
+
+	weights.assign(2 * numClassesPadded * numFeatures, 0.0f);
+
+	for (int k = 0; k < numClasses; k++) {
+		float *panel = &weights[(k / n) * numFeatures * 2 * n];
+
+		for (int j = 0; j < numFeatures; j++) {
+			int index = k * numFeaturesPadded + j;
+			panel[j * 2 * n + k % n] = model.coefficients[index];
+			panel[j * 2 * n + n + k % n] = -2.0f * model.coefficients[index] * means[index];
+		}
+	}
+#endif
+}
+
+#ifdef NAIVEBAYES_BLAS
+void Gemm::score(const float *x, int rows, float *scores) const {
+	static thread_local std::vector<float> centered;
+	static thread_local std::vector<float> squares;
+	centered.resize(rows * numFeaturesPadded);
+	squares.resize(rows * numFeaturesPadded);
+
+	for (int i = 0; i < rows * numFeaturesPadded; i++) {
+		centered[i] = x[i] - centers[i % numFeaturesPadded];
+		squares[i] = centered[i] * centered[i];
+	}
+
+	cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, rows, numClasses, numFeaturesPadded, 1.0f, squares.data(), numFeaturesPadded, weights.data(), numFeaturesPadded, 0.0f, scores, numClasses);
+	cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, rows, numClasses, numFeaturesPadded, 1.0f, centered.data(), numFeaturesPadded, weights.data() + numClasses * numFeaturesPadded, numFeaturesPadded, 1.0f, scores, numClasses);
+
+	for (int i = 0; i < rows; i++) {
+		for (int k = 0; k < numClasses; k++) {
+			scores[i * numClasses + k] += constants[k];
+		}
+	}
+}
+#else
+void Gemm::score(const float *x, int rows, float *scores) const {
+	static const micro_t micro = (kernels::isa() == kernels::AVX512) ? micro_avx512 : (kernels::isa() == kernels::AVX2) ? micro_avx2 : micro_scalar;
+
+	int m = mr();
+	int n = nr();
+
+	alignas(64) float packed[MC * KC * 2];
+	alignas(64) float c[MC * GEMM_CLASSES_MAX];
+
+	for (int i0 = 0; i0 < rows; i0 += MC) {
+		int mc = std::min(MC, rows - i0);
+		std::fill(c, c + MC * numClassesPadded, 0.0f);
+
+		for (int j0 = 0; j0 < numFeatures; j0 += KC) {
+			int kc = std::min(KC, numFeatures - j0);
+			pack(x + i0 * numFeaturesPadded + j0, numFeaturesPadded, &centers[j0], mc, kc, m, packed);
+
+			for (int ir = 0; ir < mc; ir += m) {
+				for (int p = 0; p < numClassesPadded; p += n) {
+					micro(packed + ir * kc * 2, &weights[p * numFeatures * 2 + j0 * 2 * n], kc, c + ir * numClassesPadded + p, numClassesPadded);
+				}
+			}
+		}
+
+		for (int i = 0; i < mc; i++) {
+			for (int k = 0; k < numClasses; k++) {
+				scores[(i0 + i) * numClasses + k] = c[i * numClassesPadded + k] + constants[k];
+			}
+		}
+	}
+}
+#endif
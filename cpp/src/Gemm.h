@@ -0,0 +1,56 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <vector>
+
+#include "Model.h"
+
+/**
+* Matrix-product form of a compiled Model.
+*
+* Expanding sum_j c[k][j] * (x[j] - m[k][j])^2 gives
+*   x^2 . c[k] + x . (-2 * c[k] * m[k]) + sum_j c[k][j] * m[k][j]^2
+* so a batch of examples is scored by two [N x F] . [F x K] products plus a
+* per-class constant. The products run on a cache-blocked, packed SGEMM
+* engine, or on cblas_sgemm when the host is built with NAIVEBAYES_BLAS.
+*
+* The expansion cancels in fp32 when the features sit far from zero compared
+* to their spread, so x and m are first centered on the mean of every
+* feature over the classes; the scores are unchanged.
+*/
+class Gemm {
+private:
+	int numClasses;
+	int numClassesPadded;
+	int numFeatures;
+	int numFeaturesPadded;
+
+	std::vector<float> centers;
+	std::vector<float> constants;
+	std::vector<float> weights;
+
+public:
+	Gemm();
+
+	void compile(const Model &model);
+
+	void score(const float *x, int rows, float *scores) const;
+};
+
+#endif // GEMM_H
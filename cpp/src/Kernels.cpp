@@ -0,0 +1,472 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+#include <vector>
+
+#include "Kernels.h"
+
+namespace kernels {
+
+typedef float (*loglikelihood_t)(const float *, const float *, const float *, int);
+
+// Scores a tile of rows against a tile of classes into out[r * ldo + c]
+typedef void (*tile_t)(const float *, int, const float *, const float *, int, float *, int);
+
+struct Tile {
+	int rows;
+	int classes;
+	tile_t kernel;
+};
+
+static float loglikelihood_scalar(const float *x, const float *mean, const float *coefficient, int n) {
+	float numerator = 0.0f;
+	for (int j = 0; j < n; j++) {
+		float difference = x[j] - mean[j];
+		numerator += coefficient[j] * difference * difference;
+	}
+
+	return numerator;
+}
+
+static void tile_scalar(const float *x, int ldx, const float *mean, const float *coefficient, int n, float *out, int ldo) {
+	float acc[4][2] = {};
+
+	for (int j = 0; j < n; j++) {
+		for (int c = 0; c < 2; c++) {
+			float m = mean[c * n + j];
+			float a = coefficient[c * n + j];
+
+			for (int r = 0; r < 4; r++) {
+				float difference = x[r * ldx + j] - m;
+				acc[r][c] += a * difference * difference;
+			}
+		}
+	}
+
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 2; c++) {
+			out[r * ldo + c] = acc[r][c];
+		}
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static float hsum(__m256 v) {
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+	return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma")))
+static float loglikelihood_avx2(const float *x, const float *mean, const float *coefficient, int n) {
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+
+	int j = 0;
+	for (; j + 16 <= n; j += 16) {
+		__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(x + j), _mm256_loadu_ps(mean + j));
+		__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(x + j + 8), _mm256_loadu_ps(mean + j + 8));
+		acc0 = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_loadu_ps(coefficient + j), d0), d0, acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_loadu_ps(coefficient + j + 8), d1), d1, acc1);
+	}
+	if (j < n) {
+		__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(x + j), _mm256_loadu_ps(mean + j));
+		acc0 = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_loadu_ps(coefficient + j), d0), d0, acc0);
+	}
+
+	return hsum(_mm256_add_ps(acc0, acc1));
+}
+
+// 4 rows x 2 classes keeps 8 accumulators and the 4 rows in the 16 ymm registers
+__attribute__((target("avx2,fma")))
+static void tile_avx2(const float *x, int ldx, const float *mean, const float *coefficient, int n, float *out, int ldo) {
+	__m256 acc[4][2];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 2; c++) {
+			acc[r][c] = _mm256_setzero_ps();
+		}
+	}
+
+	for (int j = 0; j < n; j += 8) {
+		__m256 features[4];
+		for (int r = 0; r < 4; r++) {
+			features[r] = _mm256_loadu_ps(x + r * ldx + j);
+		}
+
+		for (int c = 0; c < 2; c++) {
+			__m256 m = _mm256_loadu_ps(mean + c * n + j);
+			__m256 a = _mm256_loadu_ps(coefficient + c * n + j);
+
+			for (int r = 0; r < 4; r++) {
+				__m256 difference = _mm256_sub_ps(features[r], m);
+				acc[r][c] = _mm256_fmadd_ps(_mm256_mul_ps(a, difference), difference, acc[r][c]);
+			}
+		}
+	}
+
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 2; c++) {
+			out[r * ldo + c] = hsum(acc[r][c]);
+		}
+	}
+}
+
+__attribute__((target("avx512f")))
+static float loglikelihood_avx512(const float *x, const float *mean, const float *coefficient, int n) {
+	__m512 acc0 = _mm512_setzero_ps();
+	__m512 acc1 = _mm512_setzero_ps();
+
+	int j = 0;
+	for (; j + 32 <= n; j += 32) {
+		__m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(x + j), _mm512_loadu_ps(mean + j));
+		__m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(x + j + 16), _mm512_loadu_ps(mean + j + 16));
+		acc0 = _mm512_fmadd_ps(_mm512_mul_ps(_mm512_loadu_ps(coefficient + j), d0), d0, acc0);
+		acc1 = _mm512_fmadd_ps(_mm512_mul_ps(_mm512_loadu_ps(coefficient + j + 16), d1), d1, acc1);
+	}
+	for (; j < n; j += 16) {
+		__mmask16 mask = (n - j >= 16) ? 0xFFFF : 0x00FF;
+		__m512 d0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, x + j), _mm512_maskz_loadu_ps(mask, mean + j));
+		acc0 = _mm512_fmadd_ps(_mm512_mul_ps(_mm512_maskz_loadu_ps(mask, coefficient + j), d0), d0, acc0);
+	}
+
+	return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+// 4 rows x 4 classes keeps 16 accumulators and the 4 rows in the 32 zmm registers
+__attribute__((target("avx512f")))
+static void tile_avx512(const float *x, int ldx, const float *mean, const float *coefficient, int n, float *out, int ldo) {
+	__m512 acc[4][4];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			acc[r][c] = _mm512_setzero_ps();
+		}
+	}
+
+	for (int j = 0; j < n; j += 16) {
+		__mmask16 mask = (n - j >= 16) ? 0xFFFF : 0x00FF;
+
+		__m512 features[4];
+		for (int r = 0; r < 4; r++) {
+			features[r] = _mm512_maskz_loadu_ps(mask, x + r * ldx + j);
+		}
+
+		for (int c = 0; c < 4; c++) {
+			__m512 m = _mm512_maskz_loadu_ps(mask, mean + c * n + j);
+			__m512 a = _mm512_maskz_loadu_ps(mask, coefficient + c * n + j);
+
+			for (int r = 0; r < 4; r++) {
+				__m512 difference = _mm512_sub_ps(features[r], m);
+				acc[r][c] = _mm512_fmadd_ps(_mm512_mul_ps(a, difference), difference, acc[r][c]);
+			}
+		}
+	}
+
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			out[r * ldo + c] = _mm512_reduce_add_ps(acc[r][c]);
+		}
+	}
+}
+
+template <Half format>
+static float single_scalar(uint16_t h) {
+	return single(h, format);
+}
+
+template <Half format>
+static float loglikelihood_quantized(const uint8_t *q, const uint16_t *mean, const uint16_t *coefficient, int n) {
+	float numerator = 0.0f;
+	for (int j = 0; j < n; j++) {
+		float difference = q[j] - single_scalar<format>(mean[j]);
+		numerator += single_scalar<format>(coefficient[j]) * difference * difference;
+	}
+
+	return numerator;
+}
+
+// 8 uint8 codes, or 8 bf16/fp16 parameters, widened to fp32 lanes
+__attribute__((target("avx2,fma,f16c")))
+static __m256 load_codes(const uint8_t *q) {
+	return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)q)));
+}
+
+template <Half format>
+__attribute__((target("avx2,fma,f16c")))
+static __m256 load_half(const uint16_t *p) {
+	__m128i h = _mm_loadu_si128((const __m128i *)p);
+	if (format == FP16) return _mm256_cvtph_ps(h);
+	return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+}
+
+// 4 rows of codes widened to fp32 once, for all the classes they are scored
+// against
+__attribute__((target("avx2,fma,f16c")))
+static void widen_avx2(const uint8_t *q, int ldq, int n, float *x) {
+	for (int r = 0; r < 4; r++) {
+		for (int j = 0; j < n; j += 8) {
+			_mm256_storeu_ps(x + r * n + j, load_codes(q + r * ldq + j));
+		}
+	}
+}
+
+// Same 4 rows x 2 classes register blocking as tile_avx2 on widened codes,
+// with the model read at half its bytes
+template <Half format>
+__attribute__((target("avx2,fma,f16c")))
+static void tile_quantized_avx2(const float *x, int ldx, const uint16_t *mean, const uint16_t *coefficient, int n, float *out, int ldo) {
+	__m256 acc[4][2];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 2; c++) {
+			acc[r][c] = _mm256_setzero_ps();
+		}
+	}
+
+	for (int j = 0; j < n; j += 8) {
+		__m256 features[4];
+		for (int r = 0; r < 4; r++) {
+			features[r] = _mm256_loadu_ps(x + r * ldx + j);
+		}
+
+		for (int c = 0; c < 2; c++) {
+			__m256 m = load_half<format>(mean + c * n + j);
+			__m256 a = load_half<format>(coefficient + c * n + j);
+
+			for (int r = 0; r < 4; r++) {
+				__m256 difference = _mm256_sub_ps(features[r], m);
+				acc[r][c] = _mm256_fmadd_ps(_mm256_mul_ps(a, difference), difference, acc[r][c]);
+			}
+		}
+	}
+
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 2; c++) {
+			out[r * ldo + c] = hsum(acc[r][c]);
+		}
+	}
+}
+
+template <Half format>
+__attribute__((target("avx2,fma,f16c")))
+static float loglikelihood_quantized_avx2(const uint8_t *q, const uint16_t *mean, const uint16_t *coefficient, int n) {
+	__m256 acc = _mm256_setzero_ps();
+
+	for (int j = 0; j < n; j += 8) {
+		__m256 difference = _mm256_sub_ps(load_codes(q + j), load_half<format>(mean + j));
+		acc = _mm256_fmadd_ps(_mm256_mul_ps(load_half<format>(coefficient + j), difference), difference, acc);
+	}
+
+	return hsum(acc);
+}
+
+// The quantized vector kernels convert FP16 with F16C, which AVX2 does not imply
+static bool f16c() {
+	static const bool supported = isa() >= AVX2 && __builtin_cpu_supports("f16c");
+	return supported;
+}
+
+template <Half format>
+static void score_quantized(const uint8_t *q, int ldq, int rows, const float *constants, const uint16_t *means, const uint16_t *coefficients, int numClasses, int n, float *scores) {
+	// AVX-512 hosts run the AVX2 kernels too
+	bool vector = f16c();
+
+	int rowsTiled = vector ? rows - rows % 4 : 0;
+	int classesTiled = vector ? numClasses - numClasses % 2 : 0;
+
+	// Rows outermost, unlike the fp32 tiles: a row block is widened once and
+	// the half precision model is small enough to stream from L2
+	static thread_local std::vector<float> widened;
+	widened.resize(4 * n);
+
+	for (int i = 0; i < rowsTiled; i += 4) {
+		widen_avx2(q + i * ldq, ldq, n, widened.data());
+
+		for (int k = 0; k < classesTiled; k += 2) {
+			tile_quantized_avx2<format>(widened.data(), n, means + k * n, coefficients + k * n, n, scores + i * numClasses + k, numClasses);
+		}
+	}
+
+	for (int i = 0; i < rows; i++) {
+		int k = (i < rowsTiled) ? classesTiled : 0;
+		for (; k < numClasses; k++) {
+			scores[i * numClasses + k] = vector ? loglikelihood_quantized_avx2<format>(q + i * ldq, means + k * n, coefficients + k * n, n)
+				: loglikelihood_quantized<format>(q + i * ldq, means + k * n, coefficients + k * n, n);
+		}
+	}
+
+	for (int i = 0; i < rows; i++) {
+		for (int k = 0; k < numClasses; k++) {
+			scores[i * numClasses + k] += constants[k];
+		}
+	}
+}
+
+// AVX-512 is opt-in: whether the 4x4 zmm tiles beat the 4x2 ymm ones depends
+// on the host (1835 vs 1472 ns/row on 26 x 784 on one benchmark machine)
+static ISA detect() {
+	__builtin_cpu_init();
+
+	bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	bool avx512 = avx2 && __builtin_cpu_supports("avx512f");
+
+	// Forcing can only pick an instruction set the CPU supports
+	const char *forced = getenv("NAIVEBAYES_ISA");
+	if (forced) {
+		if (!strcmp(forced, "scalar")) return SCALAR;
+		if (!strcmp(forced, "avx512") && avx512) return AVX512;
+	}
+
+	return avx2 ? AVX2 : SCALAR;
+}
+
+ISA isa() {
+	static const ISA selected = detect();
+	return selected;
+}
+
+const char *name(ISA isa) {
+	switch (isa) {
+		case AVX512: return "avx512";
+		case AVX2: return "avx2";
+		default: return "scalar";
+	}
+}
+
+float loglikelihood(const float *x, const float *mean, const float *coefficient, int n) {
+	static const loglikelihood_t kernel = (isa() == AVX512) ? loglikelihood_avx512 : (isa() == AVX2) ? loglikelihood_avx2 : loglikelihood_scalar;
+	return kernel(x, mean, coefficient, n);
+}
+
+void score(const float *x, int ldx, int rows, const float *constants, const float *means, const float *coefficients, int numClasses, int n, float *scores) {
+	static const Tile tile = (isa() == AVX512) ? Tile{4, 4, tile_avx512} : (isa() == AVX2) ? Tile{4, 2, tile_avx2} : Tile{4, 2, tile_scalar};
+
+	int rowsTiled = rows - rows % tile.rows;
+	int classesTiled = numClasses - numClasses % tile.classes;
+
+	// Class tiles outermost: their model slice stays in L1 while the rows stream by
+	for (int k = 0; k < classesTiled; k += tile.classes) {
+		for (int i = 0; i < rowsTiled; i += tile.rows) {
+			tile.kernel(x + i * ldx, ldx, means + k * n, coefficients + k * n, n, scores + i * numClasses + k, numClasses);
+		}
+	}
+
+	for (int i = 0; i < rows; i++) {
+		int k = (i < rowsTiled) ? classesTiled : 0;
+		for (; k < numClasses; k++) {
+			scores[i * numClasses + k] = loglikelihood(x + i * ldx, means + k * n, coefficients + k * n, n);
+		}
+	}
+
+	for (int i = 0; i < rows; i++) {
+		for (int k = 0; k < numClasses; k++) {
+			scores[i * numClasses + k] += constants[k];
+		}
+	}
+}
+
+void topk(const float *scores, int numClasses, int k, int *classes, float *logProbabilities) {
+	float maximum = -INFINITY;
+	float sum = 0.0f;
+	int filled = 0;
+
+	for (int c = 0; c < numClasses; c++) {
+		float score = scores[c];
+
+		// Running log-sum-exp, rescaled whenever the maximum moves
+		if (score == -INFINITY) {
+			// A class without examples adds nothing, and -inf - -inf is NaN
+		} else if (score > maximum) {
+			sum = sum * expf(maximum - score) + 1.0f;
+			maximum = score;
+		} else {
+			sum += expf(score - maximum);
+		}
+
+		// Insertion into the sorted top k, kept in the output arrays
+		if (filled < k || score > logProbabilities[k - 1]) {
+			int i = (filled < k) ? filled++ : k - 1;
+			for (; i > 0 && logProbabilities[i - 1] < score; i--) {
+				logProbabilities[i] = logProbabilities[i - 1];
+				classes[i] = classes[i - 1];
+			}
+
+			logProbabilities[i] = score;
+			classes[i] = c;
+		}
+	}
+
+	float normalizer = maximum + logf(sum);
+	for (int i = 0; i < k; i++) {
+		logProbabilities[i] -= normalizer;
+	}
+}
+
+uint16_t half(float x, Half format) {
+	uint32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+
+	if (format == BF16) {
+		if (std::isnan(x)) return (bits >> 16) | 0x0040;
+		return (bits + 0x7FFF + ((bits >> 16) & 1)) >> 16;
+	}
+
+	uint16_t sign = (bits >> 16) & 0x8000;
+	float magnitude = fabsf(x);
+
+	if (std::isnan(x)) return sign | 0x7E00;
+	if (magnitude >= 65504.0f) return sign | 0x7BFF;
+	if (magnitude < 6.103515625e-05f) return sign | (uint16_t)lrintf(magnitude * 16777216.0f); // subnormal, in units of 2^-24
+
+	// Rebias the exponent from 127 to 15 and round the mantissa to 10 bits
+	uint32_t rest = bits & 0x7FFFFFFF;
+	rest += 0xFFF + ((rest >> 13) & 1);
+	return sign | ((rest - (112 << 23)) >> 13);
+}
+
+float single(uint16_t h, Half format) {
+	uint32_t bits;
+
+	if (format == BF16) {
+		bits = (uint32_t)h << 16;
+	} else {
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t exponent = (h >> 10) & 0x1F;
+		uint32_t mantissa = h & 0x3FF;
+
+		if (!exponent) {
+			float magnitude = ldexpf(mantissa, -24);
+			return sign ? -magnitude : magnitude;
+		}
+
+		bits = sign | ((exponent == 0x1F) ? 0x7F800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13));
+	}
+
+	float x;
+	memcpy(&x, &bits, sizeof(x));
+	return x;
+}
+
+void score(const uint8_t *q, int ldq, int rows, const float *constants, const uint16_t *means, const uint16_t *coefficients, Half format, int numClasses, int n, float *scores) {
+	if (format == FP16) score_quantized<FP16>(q, ldq, rows, constants, means, coefficients, numClasses, n, scores);
+	else score_quantized<BF16>(q, ldq, rows, constants, means, coefficients, numClasses, n, scores);
+}
+
+}
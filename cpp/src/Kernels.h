@@ -0,0 +1,65 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstdint>
+
+/**
+* CPU kernels for the compiled Gaussian model.
+*
+* Every kernel works on rows padded to a multiple of 8 floats (VECTORIZATION),
+* so a 256-bit lane never straddles two rows. The instruction set is picked
+* once at runtime from the CPU features: AVX2 when present, or AVX-512 when
+* the NAIVEBAYES_ISA environment variable asks for it (scalar, avx2 or
+* avx512) and the CPU has it.
+*/
+namespace kernels {
+
+enum ISA { SCALAR, AVX2, AVX512 };
+
+// 16-bit floating point formats of the quantized model parameters
+enum Half { BF16, FP16 };
+
+ISA isa();
+
+const char *name(ISA isa);
+
+// sum_j coefficient[j] * (x[j] - mean[j])^2 over n padded features
+float loglikelihood(const float *x, const float *mean, const float *coefficient, int n);
+
+// scores[i][k] = constants[k] + loglikelihood(x[i], means[k], coefficients[k])
+// for rows of x spaced ldx floats apart, evaluated in register-blocked tiles
+void score(const float *x, int ldx, int rows, const float *constants, const float *means, const float *coefficients, int numClasses, int n, float *scores);
+
+// Round to nearest even; fp16 saturates at +-65504 instead of overflowing
+uint16_t half(float x, Half format);
+
+float single(uint16_t h, Half format);
+
+// Quantized form of score: rows of ldq uint8 codes against 16-bit means and
+// coefficients in the same code units, accumulated in fp32
+void score(const uint8_t *q, int ldq, int rows, const float *constants, const uint16_t *means, const uint16_t *coefficients, Half format, int numClasses, int n, float *scores);
+
+// Fused top-k and log-sum-exp over one row of scores: classes[k] by
+// decreasing score, ties to the lower class, and logProbabilities[k] their
+// log posteriors, in one pass
+void topk(const float *scores, int numClasses, int k, int *classes, float *logProbabilities);
+
+}
+
+#endif // KERNELS_H
@@ -0,0 +1,167 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "Metrics.h"
+
+namespace metrics {
+
+struct Histogram {
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sum;
+	std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+};
+
+// Zero initialized as a static, and dumped on destruction if asked to
+static struct Registry {
+	Histogram histograms[TIMERS];
+	std::atomic<uint64_t> counters[COUNTERS];
+
+	~Registry() {
+		const char *filename = getenv("NAIVEBAYES_METRICS");
+		if (!filename) return;
+
+		try {
+			dump(filename);
+		} catch (const std::exception &e) {
+			std::cerr << e.what() << "\n";
+		}
+	}
+} registry;
+
+uint64_t Distribution::quantile(double q) const {
+	uint64_t rank = q * count;
+	uint64_t seen = 0;
+
+	for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+		seen += buckets[b];
+		if (seen > rank) return (uint64_t)1 << b;
+	}
+
+	return (uint64_t)1 << (HISTOGRAM_BUCKETS - 1);
+}
+
+uint64_t now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(Timer timer, uint64_t ns) {
+	// Smallest b with ns <= 2^b, as the Prometheus le bounds are inclusive
+	int bucket = (ns > 1) ? 64 - __builtin_clzll(ns - 1) : 0;
+	if (bucket >= HISTOGRAM_BUCKETS) bucket = HISTOGRAM_BUCKETS - 1;
+
+	Histogram &histogram = registry.histograms[timer];
+	histogram.count.fetch_add(1, std::memory_order_relaxed);
+	histogram.sum.fetch_add(ns, std::memory_order_relaxed);
+	histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void add(Counter counter, uint64_t value) {
+	registry.counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t counter(Counter counter) {
+	return registry.counters[counter].load(std::memory_order_relaxed);
+}
+
+Distribution distribution(Timer timer) {
+	const Histogram &histogram = registry.histograms[timer];
+
+	Distribution distribution;
+	distribution.count = histogram.count.load(std::memory_order_relaxed);
+	distribution.sum = histogram.sum.load(std::memory_order_relaxed);
+	for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+		distribution.buckets[b] = histogram.buckets[b].load(std::memory_order_relaxed);
+	}
+
+	return distribution;
+}
+
+const char *name(Timer timer) {
+	static const char *names[TIMERS] = {"parse", "pad", "accumulate", "finalize", "compile", "classify_block", "request"};
+	return names[timer];
+}
+
+const char *name(Counter counter) {
+	static const char *names[COUNTERS] = {"rows_parsed", "bytes_parsed", "rows_trained", "rows_classified", "requests", "bytes_to_accelerator", "bytes_from_accelerator"};
+	return names[counter];
+}
+
+void reset() {
+	for (int t = 0; t < TIMERS; t++) {
+		Histogram &histogram = registry.histograms[t];
+		histogram.count.store(0, std::memory_order_relaxed);
+		histogram.sum.store(0, std::memory_order_relaxed);
+		for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+			histogram.buckets[b].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	for (int c = 0; c < COUNTERS; c++) {
+		registry.counters[c].store(0, std::memory_order_relaxed);
+	}
+}
+
+std::string prometheus() {
+	std::ostringstream text;
+	text << std::setprecision(12);
+
+	for (int c = 0; c < COUNTERS; c++) {
+		text << "# TYPE naivebayes_" << name((Counter)c) << "_total counter\n";
+		text << "naivebayes_" << name((Counter)c) << "_total " << counter((Counter)c) << "\n";
+	}
+
+	text << "# TYPE naivebayes_phase_seconds histogram\n";
+	for (int t = 0; t < TIMERS; t++) {
+		Distribution d = distribution((Timer)t);
+
+		// Cumulative buckets up to the last non-empty one
+		int last = HISTOGRAM_BUCKETS - 1;
+		while (last > 0 && !d.buckets[last]) last--;
+
+		uint64_t cumulative = 0;
+		for (int b = 0; b <= last; b++) {
+			cumulative += d.buckets[b];
+			text << "naivebayes_phase_seconds_bucket{phase=\"" << name((Timer)t) << "\",le=\"" << (double)((uint64_t)1 << b) * 1e-9 << "\"} " << cumulative << "\n";
+		}
+
+		text << "naivebayes_phase_seconds_bucket{phase=\"" << name((Timer)t) << "\",le=\"+Inf\"} " << d.count << "\n";
+		text << "naivebayes_phase_seconds_sum{phase=\"" << name((Timer)t) << "\"} " << d.sum * 1e-9 << "\n";
+		text << "naivebayes_phase_seconds_count{phase=\"" << name((Timer)t) << "\"} " << d.count << "\n";
+	}
+
+	return text.str();
+}
+
+void dump(std::string filename) {
+	std::string text = prometheus();
+
+	FILE *file = fopen(filename.c_str(), "w");
+	if (!file) throw std::runtime_error("Cannot write " + filename);
+
+	fwrite(text.data(), 1, text.size(), file);
+	fclose(file);
+}
+
+}
@@ -0,0 +1,111 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstdint>
+#include <string>
+
+#define HISTOGRAM_BUCKETS 48 // Power of two nanosecond buckets, up to 2^47 ns
+
+/**
+* Process-wide instrumentation of the training and classification phases.
+*
+* Timers record nanosecond durations into histograms whose bucket b counts
+* the durations up to 2^b ns (and above 2^(b-1)), and counters
+* accumulate rows and bytes. Recording is a few relaxed atomic adds, so it
+* stays on the hot paths. The values are pulled with counter and
+* distribution, or exported in the Prometheus text format; setting
+* NAIVEBAYES_METRICS to a file name dumps them there at exit.
+*/
+namespace metrics {
+
+enum Timer {
+	PARSE, // Reading a batch of examples from a file
+	PAD, // Copying examples into padded rows
+	ACCUMULATE, // Accumulating the statistics of a batch
+	FINALIZE, // Turning the statistics into the model
+	COMPILE, // Compiling and publishing a model
+	CLASSIFY_BLOCK, // Scoring a block of examples on the CPU
+	REQUEST, // Accelerator request, from submit to completion
+	TIMERS
+};
+
+enum Counter {
+	ROWS_PARSED,
+	BYTES_PARSED, // Padded feature bytes produced by parsing
+	ROWS_TRAINED,
+	ROWS_CLASSIFIED, // On the CPU and on the accelerator
+	REQUESTS,
+	BYTES_TO_ACCELERATOR, // Features and model of the requests
+	BYTES_FROM_ACCELERATOR, // Predictions of the requests
+	COUNTERS
+};
+
+struct Distribution {
+	uint64_t count;
+	uint64_t sum; // ns
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+
+	// Upper bound of the bucket holding the q quantile, in ns
+	uint64_t quantile(double q) const;
+};
+
+// Monotonic clock in ns
+uint64_t now();
+
+void record(Timer timer, uint64_t ns);
+
+void add(Counter counter, uint64_t value);
+
+uint64_t counter(Counter counter);
+
+Distribution distribution(Timer timer);
+
+const char *name(Timer timer);
+
+const char *name(Counter counter);
+
+void reset();
+
+// Counters and histograms (in seconds) in the Prometheus text format
+std::string prometheus();
+
+// Throws std::runtime_error if the file cannot be written
+void dump(std::string filename);
+
+// Records the lifetime of the scope into a timer
+class Scope {
+private:
+	Timer timer;
+	uint64_t start;
+
+public:
+	Scope(Timer timer): timer(timer), start(now()) {}
+
+	~Scope() {
+		record(timer, now() - start);
+	}
+
+	Scope(const Scope &) = delete;
+
+	Scope &operator=(const Scope &) = delete;
+};
+
+}
+
+#endif // METRICS_H
@@ -0,0 +1,73 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <cmath>
+
+#include "Kernels.h"
+#include "Model.h"
+
+Model::Model(): numClasses(0), numFeatures(0), numFeaturesPadded(0), epsilon(NAN) {}
+
+void Model::compile(int numClasses, int numFeatures, int numFeaturesPadded, const float *priors, const float *means, const float *variances, float epsilon) {
+	this->numClasses = numClasses;
+	this->numFeatures = numFeatures;
+	this->numFeaturesPadded = numFeaturesPadded;
+	this->epsilon = epsilon;
+
+	this->constants.assign(numClasses, 0.0f);
+	this->means.assign(numClasses * numFeaturesPadded, 0.0f);
+	this->coefficients.assign(numClasses * numFeaturesPadded, 0.0f);
+
+	for (int k = 0; k < numClasses; k++) {
+		// A class without examples can never be predicted
+		if (!priors[k]) {
+			this->constants[k] = -INFINITY;
+			continue;
+		}
+
+		double constant = log(priors[k]);
+
+		for (int j = 0; j < numFeatures; j++) {
+			int index = k * numFeaturesPadded + j;
+			double variance = variances[index] + epsilon;
+
+			this->means[index] = means[index];
+
+			// Same guard as the Classifier kernels for degenerate features
+			if (variance) {
+				constant -= 0.5 * log(2 * M_PI * variance);
+				this->coefficients[index] = -0.5 / variance;
+			}
+		}
+
+		this->constants[k] = constant;
+	}
+}
+
+void Model::assign(int numClasses, int numFeatures, int numFeaturesPadded, const float *constants, const float *means, const float *coefficients, float epsilon) {
+	this->numClasses = numClasses;
+	this->numFeatures = numFeatures;
+	this->numFeaturesPadded = numFeaturesPadded;
+	this->epsilon = epsilon;
+
+	this->constants.assign(constants, constants + numClasses);
+	this->means.assign(means, means + numClasses * numFeaturesPadded);
+	this->coefficients.assign(coefficients, coefficients + numClasses * numFeaturesPadded);
+}
+
+void Model::score(const float *x, int rows, float *scores) const {
+	kernels::score(x, numFeaturesPadded, rows, constants.data(), means.data(), coefficients.data(), numClasses, numFeaturesPadded, scores);
+}
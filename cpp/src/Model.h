@@ -0,0 +1,51 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <vector>
+
+/**
+* Compiled form of a trained Gaussian model for a fixed epsilon.
+*
+* The log-likelihood of example x for class k becomes
+*   constants[k] + sum_j coefficients[k][j] * (x[j] - means[k][j])^2
+* with all model-only transcendentals folded into constants. Arrays are laid
+* out [numClasses][numFeaturesPadded] and the padding has a zero coefficient.
+*/
+class Model {
+public:
+	int numClasses;
+	int numFeatures;
+	int numFeaturesPadded;
+	float epsilon;
+
+	std::vector<float> constants;
+	std::vector<float> means;
+	std::vector<float> coefficients;
+
+	Model();
+
+	void compile(int numClasses, int numFeatures, int numFeaturesPadded, const float *priors, const float *means, const float *variances, float epsilon);
+
+	// Adopts a model compiled earlier, e.g. read from a ModelFile
+	void assign(int numClasses, int numFeatures, int numFeaturesPadded, const float *constants, const float *means, const float *coefficients, float epsilon);
+
+	void score(const float *x, int rows, float *scores) const;
+};
+
+#endif // MODEL_H
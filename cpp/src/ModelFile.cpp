@@ -0,0 +1,158 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "ModelFile.h"
+
+#define VECTORIZATION 8 // Padding of the features, as in NaiveBayes
+
+static_assert(sizeof(ModelHeader) == 128, "ModelHeader must be 128 bytes");
+
+static inline uint64_t align(uint64_t offset) {
+	return (offset + (MODEL_ALIGNMENT - 1)) & ~(uint64_t)(MODEL_ALIGNMENT - 1);
+}
+
+// Aligned array of size bytes past the header, wholly inside the file;
+// written without offset + size, which a corrupt header could overflow
+static bool fits(uint64_t offset, uint64_t size, uint64_t fileSize) {
+	if (offset < sizeof(ModelHeader) || offset % MODEL_ALIGNMENT || offset > fileSize) return false;
+	return size <= fileSize - offset;
+}
+
+// Every count and offset of the header checked against the file
+static bool valid(const ModelHeader *header, uint64_t fileSize) {
+	if (memcmp(header->magic, MODEL_MAGIC, sizeof(header->magic)) || header->version != MODEL_VERSION) return false;
+	if (!header->numClasses || header->numClasses > INT_MAX || !header->numFeatures || header->numFeaturesPadded > INT_MAX) return false;
+	if (header->numFeaturesPadded < header->numFeatures || header->numFeaturesPadded % VECTORIZATION) return false;
+
+	uint64_t vector = (uint64_t)header->numClasses * sizeof(float);
+	uint64_t matrix = (uint64_t)header->numClasses * header->numFeaturesPadded * sizeof(float);
+
+	if (!fits(header->priorsOffset, vector, fileSize) || !fits(header->meansOffset, matrix, fileSize) || !fits(header->variancesOffset, matrix, fileSize)) return false;
+	if (!header->constantsOffset != !header->coefficientsOffset) return false;
+
+	return !header->constantsOffset || (fits(header->constantsOffset, vector, fileSize) && fits(header->coefficientsOffset, matrix, fileSize));
+}
+
+ModelFile::ModelFile(): address(nullptr), length(0), numClasses(0), numFeatures(0), numFeaturesPadded(0), epsilon(NAN),
+	priors(nullptr), means(nullptr), variances(nullptr), constants(nullptr), coefficients(nullptr) {}
+
+ModelFile::~ModelFile() {
+	close();
+}
+
+void ModelFile::open(std::string filename) {
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Cannot open model " + filename);
+
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(ModelHeader)) {
+		::close(fd);
+		throw std::runtime_error("Invalid model " + filename);
+	}
+
+	void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED) throw std::runtime_error("Cannot map model " + filename);
+
+	const ModelHeader *header = (const ModelHeader *) mapped;
+	if (!valid(header, st.st_size)) {
+		munmap(mapped, st.st_size);
+		throw std::runtime_error("Invalid model " + filename);
+	}
+
+	address = mapped;
+	length = st.st_size;
+
+	numClasses = header->numClasses;
+	numFeatures = header->numFeatures;
+	numFeaturesPadded = header->numFeaturesPadded;
+	epsilon = header->epsilon;
+
+	const char *base = (const char *) mapped;
+	priors = (const float *) (base + header->priorsOffset);
+	means = (const float *) (base + header->meansOffset);
+	variances = (const float *) (base + header->variancesOffset);
+	constants = header->constantsOffset ? (const float *) (base + header->constantsOffset) : nullptr;
+	coefficients = header->coefficientsOffset ? (const float *) (base + header->coefficientsOffset) : nullptr;
+}
+
+void ModelFile::close() {
+	if (address) munmap(address, length);
+
+	address = nullptr;
+	length = 0;
+	priors = means = variances = constants = coefficients = nullptr;
+	epsilon = NAN;
+}
+
+bool ModelFile::compiled() const {
+	return constants != nullptr;
+}
+
+void ModelFile::write(std::string filename, int numClasses, int numFeatures, int numFeaturesPadded, const float *priors, const float *means, const float *variances, const Model *compiled) {
+	uint64_t vector = numClasses * sizeof(float);
+	uint64_t matrix = (uint64_t)numClasses * numFeaturesPadded * sizeof(float);
+
+	ModelHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+	header.version = MODEL_VERSION;
+	header.numClasses = numClasses;
+	header.numFeatures = numFeatures;
+	header.numFeaturesPadded = numFeaturesPadded;
+	header.epsilon = compiled ? compiled->epsilon : NAN;
+	header.priorsOffset = align(sizeof(header));
+	header.meansOffset = align(header.priorsOffset + vector);
+	header.variancesOffset = align(header.meansOffset + matrix);
+
+	uint64_t size = header.variancesOffset + matrix;
+	if (compiled) {
+		header.constantsOffset = align(size);
+		header.coefficientsOffset = align(header.constantsOffset + vector);
+		size = header.coefficientsOffset + matrix;
+	}
+
+	// Assembled in memory so the padding between arrays is zero
+	std::vector<char> image(size, 0);
+	memcpy(image.data(), &header, sizeof(header));
+	memcpy(image.data() + header.priorsOffset, priors, vector);
+	memcpy(image.data() + header.meansOffset, means, matrix);
+	memcpy(image.data() + header.variancesOffset, variances, matrix);
+	if (compiled) {
+		memcpy(image.data() + header.constantsOffset, compiled->constants.data(), vector);
+		memcpy(image.data() + header.coefficientsOffset, compiled->coefficients.data(), matrix);
+	}
+
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file) throw std::runtime_error("Cannot create model " + filename);
+
+	bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+
+	if (fclose(file) || !written) throw std::runtime_error("Cannot write model " + filename);
+}
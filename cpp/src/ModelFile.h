@@ -0,0 +1,91 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef MODELFILE_H
+#define MODELFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Model.h"
+
+#define MODEL_MAGIC "NBMODEL\0"
+#define MODEL_VERSION 1
+#define MODEL_ALIGNMENT 64 // Arrays start on a cache line
+
+/**
+* Binary model file, little-endian, every array at a MODEL_ALIGNMENT offset:
+*   header       | ModelHeader, 128 bytes
+*   priors       | float[numClasses]
+*   means        | float[numClasses][numFeaturesPadded], zero padded
+*   variances    | float[numClasses][numFeaturesPadded], zero padded
+*   constants    | float[numClasses], if compiled
+*   coefficients | float[numClasses][numFeaturesPadded], if compiled
+*
+* A compiled file also carries the Model for epsilon, so loading it skips
+* the transcendentals. The file is memory-mapped read-only and the arrays
+* are copied straight into the model buffers, no parsing involved.
+*/
+struct ModelHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numClasses;
+	uint32_t numFeatures;
+	uint32_t numFeaturesPadded;
+	float epsilon; // NaN if not compiled
+	uint32_t reserved;
+	uint64_t priorsOffset;
+	uint64_t meansOffset;
+	uint64_t variancesOffset;
+	uint64_t constantsOffset; // 0 if not compiled
+	uint64_t coefficientsOffset; // 0 if not compiled
+	uint64_t unused[7];
+};
+
+class ModelFile {
+private:
+	void *address;
+	size_t length;
+
+public:
+	int numClasses;
+	int numFeatures;
+	int numFeaturesPadded;
+	float epsilon;
+
+	const float *priors;
+	const float *means;
+	const float *variances;
+	const float *constants;
+	const float *coefficients;
+
+	ModelFile();
+
+	~ModelFile();
+
+	// Throws std::runtime_error if the file is missing or not a valid model
+	void open(std::string filename);
+
+	void close();
+
+	bool compiled() const;
+
+	// Writes the trained model, and its compiled form if compiled is not null
+	static void write(std::string filename, int numClasses, int numFeatures, int numFeaturesPadded, const float *priors, const float *means, const float *variances, const Model *compiled);
+};
+
+#endif // MODELFILE_H
@@ -0,0 +1,93 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <assert.h>
+#include <stdexcept>
+
+#include "ModelFile.h"
+#include "ModelSet.h"
+
+#define BLOCK 64 // Examples scored together by a CPU thread
+
+ModelSet::ModelSet(int numFeatures, int numFeaturesPadded): numFeatures(numFeatures), numFeaturesPadded(numFeaturesPadded), offsets(1, 0) {
+	model.numFeatures = numFeatures;
+	model.numFeaturesPadded = numFeaturesPadded;
+}
+
+int ModelSet::add(const Model &model) {
+	assert (model.numFeatures == numFeatures);
+	assert (model.numFeaturesPadded == numFeaturesPadded);
+
+	this->model.constants.insert(this->model.constants.end(), model.constants.begin(), model.constants.end());
+	this->model.means.insert(this->model.means.end(), model.means.begin(), model.means.end());
+	this->model.coefficients.insert(this->model.coefficients.end(), model.coefficients.begin(), model.coefficients.end());
+	this->model.numClasses += model.numClasses;
+
+	offsets.push_back(this->model.numClasses);
+
+	return size() - 1;
+}
+
+int ModelSet::load(std::string filename, float epsilon) {
+	ModelFile file;
+	file.open(filename);
+
+	if (file.numFeatures != numFeatures || file.numFeaturesPadded != numFeaturesPadded) throw std::runtime_error("Mismatched model " + filename);
+
+	Model model;
+	if (file.compiled() && file.epsilon == epsilon) model.assign(file.numClasses, numFeatures, numFeaturesPadded, file.constants, file.means, file.coefficients, epsilon);
+	else model.compile(file.numClasses, numFeatures, numFeaturesPadded, file.priors, file.means, file.variances, epsilon);
+
+	return add(model);
+}
+
+int ModelSet::size() const {
+	return offsets.size() - 1;
+}
+
+int ModelSet::numClasses(int index) const {
+	return offsets[index + 1] - offsets[index];
+}
+
+void ModelSet::classify(const float *x, int rows, int *predictions) const {
+	int models = size();
+	int classes = model.numClasses;
+
+	#pragma omp parallel
+	{
+		std::vector<float> scores(BLOCK * classes);
+
+		#pragma omp for schedule(dynamic)
+		for (int b = 0; b < rows; b += BLOCK) {
+			int n = std::min(BLOCK, rows - b);
+			model.score(x + (size_t)b * numFeaturesPadded, n, scores.data());
+
+			for (int i = 0; i < n; i++) {
+				const float *score = &scores[i * classes];
+
+				for (int m = 0; m < models; m++) {
+					int prediction = offsets[m];
+					for (int k = offsets[m] + 1; k < offsets[m + 1]; k++) {
+						if (score[k] > score[prediction]) prediction = k;
+					}
+
+					predictions[(size_t)(b + i) * models + m] = prediction - offsets[m];
+				}
+			}
+		}
+	}
+}
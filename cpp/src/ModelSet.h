@@ -0,0 +1,62 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef MODELSET_H
+#define MODELSET_H
+
+#include <string>
+#include <vector>
+
+#include "Model.h"
+
+/**
+* Many compiled models over the same features, scored in one pass.
+*
+* The classes of all models are concatenated into one wide Model, so every
+* block of examples is streamed from memory once and scored against all of
+* them while it is in cache. The argmax is then taken per model over its own
+* range of classes.
+*/
+class ModelSet {
+private:
+	int numFeatures;
+	int numFeaturesPadded;
+
+	// First class of every model in the wide model, and the total at the end
+	std::vector<int> offsets;
+
+	Model model;
+
+public:
+	ModelSet(int numFeatures, int numFeaturesPadded);
+
+	// Appends a compiled model and returns its index
+	int add(const Model &model);
+
+	// Appends the model of a ModelFile, compiled for epsilon unless the file
+	// already holds that compiled form
+	int load(std::string filename, float epsilon);
+
+	int size() const;
+
+	int numClasses(int index) const;
+
+	// predictions[rows][size()] gets the class of every example for every
+	// model, x holding rows examples of numFeaturesPadded floats
+	void classify(const float *x, int rows, int *predictions) const;
+};
+
+#endif // MODELSET_H
@@ -14,15 +14,22 @@
 * limitations under the License.
 */
 
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <cmath>
 #include <chrono>
-#include <fstream>
+#include <cstdint>
+#include <deque>
 #include <iomanip>
 #include <iostream>
 #include <omp.h>
-#include <sstream>
+#include <stdexcept>
 
+#include "Csv.h"
+#include "Kernels.h"
+#include "Metrics.h"
+#include "ModelFile.h"
 #include "NaiveBayes.h"
 
 #define NUMCLASSES_MAX 64 // Max number of model classes
@@ -32,148 +39,498 @@
 #define VECTORIZATION 8 // Vectorization of features in HW
 #define PARALLELISM 4096 // Parallelism for chunkSize in HW
 
-NaiveBayes::NaiveBayes(int numClasses, int numFeatures, int threads): numClasses(numClasses) {
+#define BLOCK 64 // Examples scored together by a CPU thread
+#define TRAIN_BLOCK 4096 // Examples accumulated together by a CPU thread
+
+#define NUM_SLOTS 3 // Accelerator buffers in flight when streaming
+
+#define HYBRID_REQUESTS 4 // Accelerator requests in flight when sharing a batch with the CPU
+#define HYBRID_CHUNK 1024 // Smallest accelerator request when sharing a batch with the CPU
+
+#define PREDICT_TILE 8 // Examples scored together by the low-latency API
+#define PREDICT_BATCH 64 // Batch size from which the low-latency API goes multithreaded
+
+NaiveBayes::NaiveBayes(int numClasses, int numFeatures, int threads): numClasses(numClasses), numFeatures(numFeatures),
+		numFeaturesPadded((numFeatures + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1))), data(nullptr), accelerator(std::make_shared<Coral>()),
+		statistics(numClasses, numFeatures, numFeaturesPadded), stale(true), engine(TILED), deterministic(false), console(std::cout.rdbuf()) {
 	assert (numClasses <= NUMCLASSES_MAX);
 	assert (numFeatures <= NUMFEATURES_MAX);
 
 	omp_set_num_threads(threads);
 
-	this->numFeatures = numFeatures;
-	this->numFeaturesPadded = (numFeatures + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1));
-
 	priors.resize(numClasses);
 	means.resize(numClasses * this->numFeaturesPadded);
 	variances.resize(numClasses * this->numFeaturesPadded);
 
-	std::cout << std::fixed;
-	std::cout << std::setprecision(2);
+	console << std::fixed;
+	console << std::setprecision(2);
+}
+
+void NaiveBayes::setEngine(Engine engine) {
+	this->engine = engine;
+}
+
+void NaiveBayes::setAccelerator(std::shared_ptr<Accelerator> accelerator) {
+	this->accelerator = accelerator;
+}
+
+void NaiveBayes::setDeterministic(bool deterministic) {
+	this->deterministic = deterministic;
+}
+
+void NaiveBayes::setVerbose(bool verbose) {
+	console.rdbuf(verbose ? std::cout.rdbuf() : nullptr);
 }
 
 void NaiveBayes::load_data(std::string filename, int numExamples) {
-	std::cout << "\n -- Reading Input File " << std::flush;
+	console << "\n -- Reading Input File " << std::flush;
 
 	auto start = std::chrono::high_resolution_clock::now();
-	labels.resize(numExamples);
+
+	if (Dataset::detect(filename)) {
+		dataset.open(filename);
+		assert (dataset.numFeatures == numFeatures);
+		assert (dataset.numFeaturesPadded == numFeaturesPadded);
+
+		if (numExamples > dataset.numExamples) numExamples = dataset.numExamples;
+		labels.assign(dataset.labels, dataset.labels + numExamples);
+
+		// The CPU paths read the mapped features in place
+		inaccel::vector<float>().swap(features);
+		data = dataset.features;
+	} else {
+		dataset.close();
+
+		numExamples = read_csv(filename, numExamples);
+		data = features.data();
+	}
 
 	chunkSize = numExamples / NUM_REQUESTS;
 	if (numExamples % NUM_REQUESTS) chunkSize++;
 
 	chunkSize = (chunkSize + (PARALLELISM - 1)) & (~(PARALLELISM - 1));
 
-	features.resize(NUM_REQUESTS * chunkSize * numFeaturesPadded);
+	codes.clear();
 
-	std::ifstream train;
-	train.open(filename.c_str());
+	auto end = std::chrono::high_resolution_clock::now();
 
-	std::string line;
-	std::string token;
-	int i = 0;
+	float seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
+	console << "took: " << seconds << "s\n";
+}
 
-	while (getline(train, line) && (i < numExamples)) {
-		std::stringstream linestream(line);
+int NaiveBayes::read_csv(std::string filename, int numExamples) {
+	labels.resize(numExamples);
 
-		getline(linestream, token, ',');
-		labels[i] = std::stoi(token);
+	int chunkSize = numExamples / NUM_REQUESTS;
+	if (numExamples % NUM_REQUESTS) chunkSize++;
 
-		for (int j = 0; j < numFeatures; j++) {
-			getline(linestream, token, ',');
-			features[i * numFeaturesPadded + j] = std::stof(token);
-		}
+	chunkSize = (chunkSize + (PARALLELISM - 1)) & (~(PARALLELISM - 1));
 
-		i++;
-	}
+	features.resize((size_t)NUM_REQUESTS * chunkSize * numFeaturesPadded);
 
-	train.close();
+	Csv csv;
+	csv.open(filename);
 
-	auto end = std::chrono::high_resolution_clock::now();
+	{
+		metrics::Scope timer(metrics::PARSE);
+		numExamples = csv.read(numExamples, numFeatures, numFeaturesPadded, labels.data(), features.data());
+	}
 
-	float seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
-	std::cout << "took: " << seconds << "s\n";
+	metrics::add(metrics::ROWS_PARSED, numExamples);
+	metrics::add(metrics::BYTES_PARSED, (size_t)numExamples * numFeaturesPadded * sizeof(float));
+	labels.resize(numExamples);
+
+	return numExamples;
 }
 
 void NaiveBayes::train(std::string filename, int numExamples) {
 	load_data(filename, numExamples);
+	fit();
+}
+
+void NaiveBayes::fit() {
+	console << "\n -- Training " << std::flush;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	statistics = Statistics(numClasses, numFeatures, numFeaturesPadded);
+	accumulate(statistics, data, labels.data(), labels.size());
+	{
+		metrics::Scope timer(metrics::FINALIZE);
+		statistics.finalize(priors.data(), means.data(), variances.data());
+	}
+
+	stale = true;
 
-	std::cout << "\n -- Training " << std::flush;
+	auto end = std::chrono::high_resolution_clock::now();
+
+	float seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
+	console << "took: " << seconds << "s\n";
+}
+
+void NaiveBayes::trainStream(std::string filename, int chunkRows) {
+	console << "\n -- Streaming Training " << std::flush;
 
 	auto start = std::chrono::high_resolution_clock::now();
 
-	int *class_cnt = (int *) malloc(numClasses * sizeof(int));
+	Reader reader(numFeatures, numFeaturesPadded);
+	reader.open(filename);
+
+	statistics = Statistics(numClasses, numFeatures, numFeaturesPadded);
+
+	std::vector<int> chunkLabels[2];
+	std::vector<float> chunkFeatures[2];
+
+	// Chunk c is accumulated while chunk c ^ 1 is being read
+	std::future<int> next = stream(reader, chunkRows, chunkLabels[0], chunkFeatures[0]);
+
+	for (int c = 0;; c ^= 1) {
+		int rows = next.get();
+		if (!rows) break;
+
+		next = stream(reader, chunkRows, chunkLabels[c ^ 1], chunkFeatures[c ^ 1]);
 
-	float *sums, *sq_sums, *sq_feature_means;
-	sums = (float *) malloc(numClasses * numFeatures * sizeof(float));
-	sq_sums = (float *) malloc(numClasses * numFeatures * sizeof(float));
-	sq_feature_means = (float *) malloc(numClasses * numFeatures * sizeof(float));
+		accumulate(statistics, chunkFeatures[c].data(), chunkLabels[c].data(), rows);
+	}
+
+	{
+		metrics::Scope timer(metrics::FINALIZE);
+		statistics.finalize(priors.data(), means.data(), variances.data());
+	}
+
+	stale = true;
+
+	auto end = std::chrono::high_resolution_clock::now();
 
-	for (int k = 0; k < numClasses; k++) {
-		class_cnt[k] = 0;
+	float seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
+	console << "took: " << seconds << "s\n";
+}
 
-		for (int j = 0; j < numFeatures; j++) {
-			sums[k * numFeatures + j] = 0;
-			sq_sums[k * numFeatures + j] = 0;
+std::future<int> NaiveBayes::stream(Reader &reader, int chunkRows, std::vector<int> &chunkLabels, std::vector<float> &chunkFeatures) {
+	chunkLabels.resize(chunkRows);
+	chunkFeatures.resize(chunkRows * numFeaturesPadded);
+
+	return std::async(std::launch::async, [this, &reader, chunkRows, &chunkLabels, &chunkFeatures] {
+		return parse(reader, chunkRows, chunkLabels.data(), chunkFeatures.data());
+	});
+}
+
+int NaiveBayes::parse(Reader &reader, int rows, int *labels, float *x) {
+	metrics::Scope timer(metrics::PARSE);
+
+	rows = reader.read(rows, labels, x);
+
+	metrics::add(metrics::ROWS_PARSED, rows);
+	metrics::add(metrics::BYTES_PARSED, (size_t)rows * numFeaturesPadded * sizeof(float));
+
+	return rows;
+}
+
+// Node of the fixed reduction tree over training blocks: covers the blocks
+// [begin, begin + 2^level), or fewer at the end of the examples
+struct Partial {
+	int level;
+	int begin;
+	Statistics statistics;
+};
+
+// Pushes a node and merges it with its left sibling while there is one, so
+// a stack holds at most one node per level
+static void push(std::vector<Partial> &stack, Partial partial) {
+	stack.push_back(std::move(partial));
+
+	while (stack.size() > 1) {
+		Partial &left = stack[stack.size() - 2];
+		Partial &right = stack.back();
+
+		if (left.level != right.level || left.begin % (2 << left.level) || right.begin != left.begin + (1 << left.level)) break;
+
+		left.statistics.merge(right.statistics);
+		left.level++;
+		stack.pop_back();
+	}
+}
+
+void NaiveBayes::accumulate(Statistics &statistics, const float *x, const int *labels, int numExamples) {
+	metrics::Scope timer(metrics::ACCUMULATE);
+	metrics::add(metrics::ROWS_TRAINED, numExamples);
+
+	int numBlocks = (numExamples + (TRAIN_BLOCK - 1)) / TRAIN_BLOCK;
+
+	if (!deterministic) {
+		std::vector<Statistics> partials(omp_get_max_threads(), Statistics(numClasses, numFeatures, numFeaturesPadded));
+
+		#pragma omp parallel for schedule(static)
+		for (int b = 0; b < numBlocks; b++) {
+			int rows = std::min(TRAIN_BLOCK, numExamples - b * TRAIN_BLOCK);
+			partials[omp_get_thread_num()].accumulate(x + (size_t)b * TRAIN_BLOCK * numFeaturesPadded, labels + b * TRAIN_BLOCK, rows);
 		}
+
+		Statistics::reduce(partials);
+		statistics.merge(partials[0]);
+		return;
 	}
 
-	for (int i = 0; i < labels.size(); i++) {
-		int label = labels[i];
-		class_cnt[label]++;
+	// Deterministic mode sums every block on its own and merges the blocks
+	// along a pairwise tree fixed by their count, so the bits do not depend
+	// on the number of threads. Every thread takes a contiguous run of blocks
+	// and merges its nodes as they complete, keeping O(log blocks) partials.
+	std::vector<std::vector<Partial>> stacks(omp_get_max_threads());
+
+	#pragma omp parallel
+	{
+		int t = omp_get_thread_num();
+		int n = omp_get_num_threads();
+		int first = (long long)numBlocks * t / n;
+		int last = (long long)numBlocks * (t + 1) / n;
 
-		for (int j = 0; j < numFeatures; j++) {
-			float data = features[i * numFeaturesPadded + j];
-			sums[label * numFeatures + j] += data;
-			sq_sums[label * numFeatures + j] += data * data;
+		for (int b = first; b < last; b++) {
+			int rows = std::min(TRAIN_BLOCK, numExamples - b * TRAIN_BLOCK);
+
+			Partial leaf = {0, b, Statistics(numClasses, numFeatures, numFeaturesPadded)};
+			leaf.statistics.accumulate(x + (size_t)b * TRAIN_BLOCK * numFeaturesPadded, labels + b * TRAIN_BLOCK, rows);
+
+			push(stacks[t], std::move(leaf));
+		}
+	}
+
+	// The nodes left by each thread complete across thread boundaries
+	std::vector<Partial> stack;
+	for (auto &nodes : stacks) {
+		for (Partial &partial : nodes) {
+			push(stack, std::move(partial));
 		}
 	}
 
-	for (int k = 0; k < numClasses; k++) {
-		priors[k] = class_cnt[k] / (float)numFeatures;
+	if (stack.empty()) return;
+
+	// A node cut short by the end of the examples has no right sibling and
+	// joins the tree one level up as is
+	while (stack.size() > 1) {
+		stack[stack.size() - 2].statistics.merge(stack.back().statistics);
+		stack.pop_back();
+	}
+
+	statistics.merge(stack[0].statistics);
+}
+
+void NaiveBayes::compile(float epsilon) {
+	if (!stale) {
+		SnapshotDomain::Pin current(snapshots);
+		if (current.get() && current->model.epsilon == epsilon) return;
+	}
+
+	metrics::Scope timer(metrics::COMPILE);
+
+	Snapshot *snapshot = new Snapshot();
+	snapshot->model.compile(numClasses, numFeatures, numFeaturesPadded, priors.data(), means.data(), variances.data(), epsilon);
+
+	publish(snapshot);
+}
+
+void NaiveBayes::publish(Snapshot *snapshot) {
+	snapshot->priors.assign(priors.begin(), priors.end());
+	snapshot->means.assign(means.begin(), means.end());
+	snapshot->variances.assign(variances.begin(), variances.end());
+	snapshot->gemm.compile(snapshot->model);
+	snapshot->bf16.compile(snapshot->model, statistics.minimums.data(), statistics.maximums.data(), kernels::BF16);
+	snapshot->fp16.compile(snapshot->model, statistics.minimums.data(), statistics.maximums.data(), kernels::FP16);
+
+	// Codes follow the feature ranges of the model
+	codes.clear();
 
-		for (int j = 0; j < numFeatures; j++) {
-			means[k * numFeatures + j] = sums[k * numFeatures + j] / (float)class_cnt[k];
-			sq_feature_means[k * numFeatures + j] = sq_sums[k * numFeatures + j] / (float)class_cnt[k];
-			variances[k * numFeatures + j] = sq_feature_means[k * numFeatures + j] - (means[k * numFeatures + j] * means[k * numFeatures + j]);
+	snapshots.publish(snapshot);
+	stale = false;
+}
+
+void NaiveBayes::partial_fit(const float *x, const int *labels, int n) {
+	// Labels index the per-class accumulators, checked before any is touched
+	for (int i = 0; i < n; i++) {
+		if (labels[i] < 0 || labels[i] >= numClasses) throw std::runtime_error("Label " + std::to_string(labels[i]) + " out of range in partial_fit");
+	}
+
+	batch.resize((size_t)n * numFeaturesPadded);
+
+	{
+		metrics::Scope timer(metrics::PAD);
+
+		for (int i = 0; i < n; i++) {
+			std::copy(x + (size_t)i * numFeatures, x + (size_t)(i + 1) * numFeatures, batch.begin() + (size_t)i * numFeaturesPadded);
+			std::fill(batch.begin() + (size_t)i * numFeaturesPadded + numFeatures, batch.begin() + (size_t)(i + 1) * numFeaturesPadded, 0.0f);
 		}
 	}
 
-	free(sums);
-	free(sq_sums);
-	free(sq_feature_means);
+	accumulate(statistics, batch.data(), labels, n);
+	{
+		metrics::Scope timer(metrics::FINALIZE);
+		statistics.finalize(priors.data(), means.data(), variances.data());
+	}
+
+	stale = true;
+
+	float epsilon = NAN;
+	{
+		SnapshotDomain::Pin current(snapshots);
+		if (current.get()) epsilon = current->model.epsilon;
+	}
+
+	if (!std::isnan(epsilon)) compile(epsilon);
+}
+
+void NaiveBayes::save(std::string filename, bool compiled) const {
+	SnapshotDomain::Pin current(snapshots);
+	assert (!compiled || (current.get() && !stale));
+
+	ModelFile::write(filename, numClasses, numFeatures, numFeaturesPadded, priors.data(), means.data(), variances.data(), compiled ? &current->model : nullptr);
+}
+
+void NaiveBayes::load(std::string filename) {
+	console << "\n -- Loading Model " << std::flush;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	ModelFile file;
+	file.open(filename);
+	assert (file.numClasses == numClasses);
+	assert (file.numFeatures == numFeatures);
+	assert (file.numFeaturesPadded == numFeaturesPadded);
+
+	std::copy(file.priors, file.priors + numClasses, priors.begin());
+	std::copy(file.means, file.means + numClasses * numFeaturesPadded, means.begin());
+	std::copy(file.variances, file.variances + numClasses * numFeaturesPadded, variances.begin());
+
+	statistics.restore(file.priors, file.means, file.variances);
+
+	stale = true;
+	if (file.compiled()) {
+		Snapshot *snapshot = new Snapshot();
+		snapshot->model.assign(numClasses, numFeatures, numFeaturesPadded, file.constants, file.means, file.coefficients, file.epsilon);
+
+		publish(snapshot);
+	} else {
+		// The previous compiled model belongs to other statistics
+		snapshots.publish(nullptr);
+	}
 
 	auto end = std::chrono::high_resolution_clock::now();
 
 	float seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
-	std::cout << "took: " << seconds << "s\n";
+	console << "took: " << seconds << "s\n";
 }
 
 void NaiveBayes::classify(float epsilon, int hw) {
-	std::cout << "\n -- Classification " << std::flush;
+	console << "\n -- Classification " << std::flush;
 
 	auto start = std::chrono::high_resolution_clock::now();
 
 	predictions.resize(NUM_REQUESTS * chunkSize);
 
-	if (hw) classifyHW(epsilon);
+	if (hw == HYBRID) classifyHybrid(epsilon);
+	else if (hw == AUTO) classifyAuto(epsilon);
+	else if (hw) classifyHW(epsilon);
 	else classifySW(epsilon);
 
 	auto end = std::chrono::high_resolution_clock::now();
 
 	float seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
-	std::cout << "took: " << seconds << "s\n";
+	console << "took: " << seconds << "s\n";
+}
+
+const int *NaiveBayes::getPredictions() const {
+	return predictions.data();
+}
+
+Model NaiveBayes::getModel() const {
+	SnapshotDomain::Pin snapshot(snapshots);
+	if (!snapshot.get()) throw std::runtime_error("No compiled model, call compile first");
+
+	return snapshot->model;
 }
 
 void NaiveBayes::classifySW(float epsilon) {
-	#pragma omp parallel for
-	for (int i = 0; i < labels.size(); i++) {
+	compile(epsilon);
+
+	SnapshotDomain::Pin snapshot(snapshots);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (engine == BF16 || engine == FP16) classifyCodes(engine == BF16 ? snapshot->bf16 : snapshot->fp16);
+	else classifyRows(*snapshot.get(), engine, data, labels.size(), predictions.data());
+
+	auto end = std::chrono::high_resolution_clock::now();
+	dispatcher.observeSW(labels.size(), std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// The dataset is coded once per model and then scored from a quarter of the
+// bytes on every following classification
+void NaiveBayes::classifyCodes(const Quantized &quantized) {
+	int numExamples = labels.size();
+
+	if (codes.empty()) {
+		codes.resize((size_t)numExamples * numFeaturesPadded);
+
+		#pragma omp parallel for schedule(static)
+		for (int b = 0; b < numExamples; b += BLOCK) {
+			quantized.quantize(data + (size_t)b * numFeaturesPadded, numFeaturesPadded, std::min(BLOCK, numExamples - b), codes.data() + (size_t)b * numFeaturesPadded);
+		}
+	}
+
+	#pragma omp parallel
+	{
+		std::vector<float> scores(BLOCK * numClasses);
+
+		#pragma omp for schedule(dynamic)
+		for (int b = 0; b < numExamples; b += BLOCK) {
+			int rows = std::min(BLOCK, numExamples - b);
+
+			metrics::Scope timer(metrics::CLASSIFY_BLOCK);
+			metrics::add(metrics::ROWS_CLASSIFIED, rows);
+
+			quantized.score(codes.data() + (size_t)b * numFeaturesPadded, rows, scores.data());
+			argmax(scores.data(), rows, predictions.data() + b);
+		}
+	}
+}
+
+void NaiveBayes::classifyRows(const Snapshot &snapshot, Engine engine, const float *x, int numExamples, int *predictions) {
+	#pragma omp parallel
+	{
+		std::vector<float> scores(BLOCK * numClasses);
+
+		#pragma omp for schedule(dynamic)
+		for (int b = 0; b < numExamples; b += BLOCK) {
+			classifyBlock(snapshot, engine, x + (size_t)b * numFeaturesPadded, std::min(BLOCK, numExamples - b), predictions + b, scores.data());
+		}
+	}
+}
+
+void NaiveBayes::classifyBlock(const Snapshot &snapshot, Engine engine, const float *x, int rows, int *predictions, float *scores) {
+	metrics::Scope timer(metrics::CLASSIFY_BLOCK);
+	metrics::add(metrics::ROWS_CLASSIFIED, rows);
+
+	if (engine == BF16 || engine == FP16) {
+		const Quantized &quantized = (engine == BF16) ? snapshot.bf16 : snapshot.fp16;
+
+		// Per thread, so the worker stacks stay small
+		static thread_local std::vector<uint8_t> codes;
+		codes.resize(BLOCK * numFeaturesPadded);
+
+		quantized.quantize(x, numFeaturesPadded, rows, codes.data());
+		quantized.score(codes.data(), rows, scores);
+	}
+	else if (engine == GEMM) snapshot.gemm.score(x, rows, scores);
+	else snapshot.model.score(x, rows, scores);
+
+	argmax(scores, rows, predictions);
+}
+
+void NaiveBayes::argmax(const float *scores, int rows, int *predictions) const {
+	for (int i = 0; i < rows; i++) {
 		float max_likelihood = -INFINITY;
 
 		for (int k = 0; k < numClasses; k++) {
-			float numerator = log(priors[k]);
-			for (int j = 0; j < numFeatures; j++) {
-				numerator += log(1 / sqrt(2 * M_PI * (variances[k * numFeatures + j] + epsilon))) + ((-1 * (features[i * numFeatures + j] - means[k * numFeatures + j]) * (features[i * numFeatures + j] - means[k * numFeatures + j])) / (2 * (variances[k * numFeatures + j] + epsilon)));
-			}
-
-			if (numerator > max_likelihood) {
-				max_likelihood = numerator;
+			if (scores[i * numClasses + k] > max_likelihood) {
+				max_likelihood = scores[i * numClasses + k];
 				predictions[i] = k;
 			}
 		}
@@ -181,26 +538,207 @@ void NaiveBayes::classifySW(float epsilon) {
 }
 
 void NaiveBayes::classifyHW(float epsilon) {
-	std::vector<std::future<void>> responses(NUM_REQUESTS);
-	for (int n = 0; n < NUM_REQUESTS; n++) {
-		inaccel::request nbc("com.inaccel.ml.NaiveBayes.Classifier");
+	compile(epsilon);
+	stage();
 
-		nbc.arg<float>(features.begin() + n * chunkSize * numFeatures, features.begin() + (n + 1) * chunkSize * numFeatures)
-			.arg(means)
-			.arg(variances)
-			.arg(priors)
-			.arg<int>(predictions.begin() + n * chunkSize, predictions.begin() + (n + 1) * chunkSize)
-			.arg(epsilon)
-			.arg(numClasses)
-			.arg(numFeatures)
-			.arg(chunkSize);
+	SnapshotDomain::Pin snapshot(snapshots);
 
-		responses[n] = inaccel::submit(nbc);
-	}
+	auto start = std::chrono::high_resolution_clock::now();
 
+	std::vector<Request> responses = offload(*snapshot.get(), epsilon, NUM_REQUESTS, chunkSize);
 	for (int n = 0; n < NUM_REQUESTS; n++) {
 		responses[n].get();
 	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double bytes = NUM_REQUESTS * (chunkSize * (numFeaturesPadded + 1) + numClasses * (2 * numFeaturesPadded + 1)) * sizeof(float);
+	dispatcher.observeHW(NUM_REQUESTS, bytes, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// Sends the head of the batch to the accelerator and the tail to the CPU
+// threads, split where the cost model expects both to finish together
+void NaiveBayes::classifyAuto(float epsilon) {
+	compile(epsilon);
+
+	SnapshotDomain::Pin snapshot(snapshots);
+
+	int numExamples = labels.size();
+
+	// Features and predictions per example, model per request
+	double rowBytes = (numFeaturesPadded + 1) * sizeof(float);
+	double requestBytes = numClasses * (2 * numFeaturesPadded + 1) * sizeof(float);
+
+	int hwRows = dispatcher.split(numExamples, rowBytes, requestBytes, NUM_REQUESTS, PARALLELISM, VECTORIZATION);
+	int requests = 0;
+	int requestRows = 0;
+
+	std::vector<Request> responses;
+	std::future<double> hw;
+
+	if (hwRows) {
+		stage();
+
+		// Equal requests of whole kernel chunks, the last one may reach past
+		// the examples into the zero padded buffer
+		requests = Dispatcher::requests(hwRows, NUM_REQUESTS, PARALLELISM);
+		requestRows = (hwRows + requests - 1) / requests;
+		requestRows = (requestRows + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1));
+		hwRows = std::min(numExamples, requests * requestRows);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		responses = offload(*snapshot.get(), epsilon, requests, requestRows);
+		hw = std::async(std::launch::async, [&responses, start] {
+			for (auto &response : responses) {
+				response.get();
+			}
+
+			auto end = std::chrono::high_resolution_clock::now();
+			return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		});
+	}
+
+	console << "(" << (100 * (float)(hwRows) / numExamples) << "% on HW) " << std::flush;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	classifyRows(*snapshot.get(), engine, data + (size_t)hwRows * numFeaturesPadded, numExamples - hwRows, predictions.data() + hwRows);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	dispatcher.observeSW(numExamples - hwRows, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+	if (hwRows) {
+		dispatcher.observeHW(requests, requests * (requestRows * rowBytes + requestBytes), hw.get());
+	}
+}
+
+// Unclaimed examples [head, tail) packed in one word, head in the high half
+static inline uint64_t pack(uint32_t head, uint32_t tail) {
+	return ((uint64_t)head << 32) | tail;
+}
+
+// Both engines work on the batch at once: the accelerator claims large chunks
+// from the head, keeping up to HYBRID_REQUESTS in flight, while the CPU threads
+// claim blocks of BLOCK examples from the tail until the two meet
+void NaiveBayes::classifyHybrid(float epsilon) {
+	compile(epsilon);
+	stage();
+
+	SnapshotDomain::Pin snapshot(snapshots);
+
+	int numExamples = labels.size();
+	std::atomic<uint64_t> range(pack(0, numExamples));
+
+	// The head only moves by whole kernel chunks and every tail but the first
+	// is a multiple of VECTORIZATION, so a request never covers CPU examples
+	auto head = [&range](int &begin, int &end) {
+		uint64_t current = range.load();
+		for (;;) {
+			int h = current >> 32, t = (uint32_t) current;
+			if (h >= t) return false;
+
+			// Guided: a share of what is left, so the last requests are short
+			int rows = std::max(HYBRID_CHUNK, (t - h) / (4 * HYBRID_REQUESTS));
+			rows = std::min(rows & (~(VECTORIZATION - 1)), t - h);
+
+			if (range.compare_exchange_weak(current, pack(h + rows, t))) {
+				begin = h;
+				end = h + rows;
+				return true;
+			}
+		}
+	};
+
+	auto tail = [&range](int &begin, int &end) {
+		uint64_t current = range.load();
+		for (;;) {
+			int h = current >> 32, t = (uint32_t) current;
+			if (h >= t) return false;
+
+			int rows = std::max(h, (t - BLOCK + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1)));
+
+			if (range.compare_exchange_weak(current, pack(h, rows))) {
+				begin = rows;
+				end = t;
+				return true;
+			}
+		}
+	};
+
+	std::future<int> hw = std::async(std::launch::async, [this, epsilon, &head, &snapshot] {
+		std::deque<Request> responses;
+		int claimed = 0;
+
+		int begin, end;
+		while (head(begin, end)) {
+			if (responses.size() == HYBRID_REQUESTS) {
+				responses.front().get();
+				responses.pop_front();
+			}
+
+			// Past the examples the request reads the zero padded buffer
+			int requestRows = ((end - begin) + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1));
+			responses.push_back(submit(*snapshot.get(), features.begin() + (size_t)begin * numFeaturesPadded, predictions.begin() + begin, epsilon, requestRows));
+			claimed += end - begin;
+		}
+
+		for (auto &response : responses) {
+			response.get();
+		}
+
+		return claimed;
+	});
+
+	#pragma omp parallel
+	{
+		std::vector<float> scores(BLOCK * numClasses);
+
+		int begin, end;
+		while (tail(begin, end)) {
+			classifyBlock(*snapshot.get(), engine, data + (size_t)begin * numFeaturesPadded, end - begin, predictions.data() + begin, scores.data());
+		}
+	}
+
+	int hwRows = hw.get();
+	console << "(" << (100 * (float)(hwRows) / numExamples) << "% on HW) " << std::flush;
+}
+
+void NaiveBayes::stage() {
+	// Mapped datasets are staged into the accelerator buffer on first use
+	if (features.empty()) {
+		metrics::Scope timer(metrics::PAD);
+
+		features.resize((size_t)NUM_REQUESTS * chunkSize * numFeaturesPadded);
+		std::copy(data, data + labels.size() * numFeaturesPadded, features.begin());
+	}
+}
+
+std::vector<Request> NaiveBayes::offload(Snapshot &snapshot, float epsilon, int requests, int requestRows) {
+	std::vector<Request> responses(requests);
+	for (int n = 0; n < requests; n++) {
+		responses[n] = submit(snapshot, features.begin() + (size_t)n * requestRows * numFeaturesPadded, predictions.begin() + n * requestRows, epsilon, requestRows);
+	}
+
+	return responses;
+}
+
+Request NaiveBayes::submit(Snapshot &snapshot, inaccel::vector<float>::iterator x, inaccel::vector<int>::iterator predictions, float epsilon, int rows) {
+	metrics::add(metrics::REQUESTS, 1);
+	metrics::add(metrics::ROWS_CLASSIFIED, rows);
+	metrics::add(metrics::BYTES_TO_ACCELERATOR, ((size_t)rows * numFeaturesPadded + numClasses * (2 * numFeaturesPadded + 1)) * sizeof(float));
+	metrics::add(metrics::BYTES_FROM_ACCELERATOR, (size_t)rows * sizeof(int));
+
+	uint64_t start = metrics::now();
+	return Request{accelerator->classify(x, x + (size_t)rows * numFeaturesPadded, snapshot.means, snapshot.variances, snapshot.priors,
+		predictions, predictions + rows, epsilon, numClasses, numFeatures, rows), start};
+}
+
+// Requests are waited on in submit order, so a latency includes the wait
+// for the requests ahead of it
+void Request::get() {
+	response.get();
+	metrics::record(metrics::REQUEST, metrics::now() - start);
 }
 
 void NaiveBayes::predict(float epsilon, int hw) {
@@ -211,5 +749,236 @@ void NaiveBayes::predict(float epsilon, int hw) {
 		if (predictions[i] == labels[i]) cor++;
 	}
 
-	std::cout << "\n -- Accuracy: " << (100 * (float)(cor) / labels.size()) << " % (" << cor << "/" << labels.size() << ")\n\n";
+	console << "\n -- Accuracy: " << (100 * (float)(cor) / labels.size()) << " % (" << cor << "/" << labels.size() << ")\n";
+
+	// Reduced precision is validated against the fp32 scores of the same model
+	if (engine == BF16 || engine == FP16) {
+		SnapshotDomain::Pin snapshot(snapshots);
+
+		std::vector<int> reference(labels.size());
+		classifyRows(*snapshot.get(), TILED, data, labels.size(), reference.data());
+
+		int fp32 = 0, agree = 0;
+		for (int i = 0; i < labels.size(); i++) {
+			if (reference[i] == labels[i]) fp32++;
+			if (reference[i] == predictions[i]) agree++;
+		}
+
+		console << " -- FP32 Accuracy: " << (100 * (float)(fp32) / labels.size()) << " % (" << fp32 << "/" << labels.size() << "), "
+			<< (100 * (float)(agree) / labels.size()) << " % of the predictions agree\n";
+	}
+
+	console << "\n";
+}
+
+void NaiveBayes::predictStream(std::string filename, float epsilon, int hw, int chunkRows) {
+	console << "\n -- Streaming Classification " << std::flush;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Reader reader(numFeatures, numFeaturesPadded);
+	reader.open(filename);
+
+	long long cor = 0;
+	long long total = 0;
+
+	if (hw) streamHW(reader, epsilon, chunkRows, cor, total);
+	else streamSW(reader, epsilon, chunkRows, cor, total);
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	float seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
+	console << "took: " << seconds << "s\n";
+
+	console << "\n -- Accuracy: " << (100 * (float)(cor) / total) << " % (" << cor << "/" << total << ")\n\n";
+}
+
+void NaiveBayes::streamSW(Reader &reader, float epsilon, int chunkRows, long long &cor, long long &total) {
+	compile(epsilon);
+
+	SnapshotDomain::Pin snapshot(snapshots);
+
+	std::vector<int> chunkLabels[2];
+	std::vector<float> chunkFeatures[2];
+	std::vector<int> chunkPredictions(chunkRows);
+
+	// Chunk c is classified while chunk c ^ 1 is being read
+	std::future<int> next = stream(reader, chunkRows, chunkLabels[0], chunkFeatures[0]);
+
+	for (int c = 0;; c ^= 1) {
+		int rows = next.get();
+		if (!rows) break;
+
+		next = stream(reader, chunkRows, chunkLabels[c ^ 1], chunkFeatures[c ^ 1]);
+
+		classifyRows(*snapshot.get(), engine, chunkFeatures[c].data(), rows, chunkPredictions.data());
+
+		for (int i = 0; i < rows; i++) {
+			if (chunkPredictions[i] == chunkLabels[c][i]) cor++;
+		}
+		total += rows;
+	}
+}
+
+// Ring of accelerator buffers: while chunk n is on the accelerator, chunk n + 1
+// is parsed into the next slot and chunk n - 1 may still be completing
+struct Slot {
+	inaccel::vector<float> features;
+	inaccel::vector<int> predictions;
+	std::vector<int> labels;
+	std::future<int> parsed;
+	Request response;
+	int rows;
+};
+
+void NaiveBayes::streamHW(Reader &reader, float epsilon, int chunkRows, long long &cor, long long &total) {
+	compile(epsilon);
+
+	SnapshotDomain::Pin snapshot(snapshots);
+
+	// Requests cover whole kernel chunks of 8 examples
+	chunkRows = (chunkRows + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1));
+
+	std::vector<Slot> ring(NUM_SLOTS);
+	for (int s = 0; s < NUM_SLOTS; s++) {
+		ring[s].features.resize(chunkRows * numFeaturesPadded);
+		ring[s].predictions.resize(chunkRows);
+		ring[s].labels.resize(chunkRows);
+		ring[s].rows = 0;
+	}
+
+	auto parse = [&reader, chunkRows, this](Slot &slot) {
+		return std::async(std::launch::async, [&reader, chunkRows, &slot, this] {
+			int rows = this->parse(reader, chunkRows, slot.labels.data(), slot.features.data());
+
+			// Zero the tail of a short chunk so the padding examples are defined
+			std::fill(slot.features.begin() + rows * numFeaturesPadded, slot.features.end(), 0.0f);
+			return rows;
+		});
+	};
+
+	auto collect = [&cor, &total](Slot &slot) {
+		if (!slot.rows) return;
+
+		slot.response.get();
+		for (int i = 0; i < slot.rows; i++) {
+			if (slot.predictions[i] == slot.labels[i]) cor++;
+		}
+		total += slot.rows;
+		slot.rows = 0;
+	};
+
+	ring[0].parsed = parse(ring[0]);
+
+	for (int n = 0;; n++) {
+		Slot &current = ring[n % NUM_SLOTS];
+		Slot &next = ring[(n + 1) % NUM_SLOTS];
+
+		int rows = current.parsed.get();
+		if (!rows) break;
+
+		int requestRows = (rows + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1));
+		current.response = submit(*snapshot.get(), current.features.begin(), current.predictions.begin(), epsilon, requestRows);
+		current.rows = rows;
+
+		collect(next);
+		next.parsed = parse(next);
+	}
+
+	for (int s = 0; s < NUM_SLOTS; s++) {
+		collect(ring[s]);
+	}
+}
+
+void NaiveBayes::predict(const float *x, int n, int *out) const {
+	score(x, n, out, nullptr, 0, nullptr, nullptr);
+}
+
+void NaiveBayes::predict_proba(const float *x, int n, float *proba) const {
+	score(x, n, nullptr, proba, 0, nullptr, nullptr);
+}
+
+void NaiveBayes::predict_topk(const float *x, int n, int k, int *classes, float *logProbabilities) const {
+	assert (k > 0 && k <= numClasses);
+
+	score(x, n, nullptr, nullptr, k, classes, logProbabilities);
+}
+
+void NaiveBayes::score(const float *x, int n, int *out, float *proba, int top, int *classes, float *logProbabilities) const {
+	SnapshotDomain::Pin snapshot(snapshots);
+	if (!snapshot.get()) throw std::runtime_error("No compiled model, call compile first");
+
+	const Model &model = snapshot->model;
+
+	if (n >= PREDICT_BATCH) {
+		#pragma omp parallel for schedule(static)
+		for (int b = 0; b < n; b += PREDICT_TILE) {
+			scoreTile(model, x + (size_t)b * numFeatures, std::min(PREDICT_TILE, n - b), out ? out + b : nullptr, proba ? proba + (size_t)b * numClasses : nullptr,
+				top, classes ? classes + (size_t)b * top : nullptr, logProbabilities ? logProbabilities + (size_t)b * top : nullptr);
+		}
+	} else {
+		for (int b = 0; b < n; b += PREDICT_TILE) {
+			scoreTile(model, x + (size_t)b * numFeatures, std::min(PREDICT_TILE, n - b), out ? out + b : nullptr, proba ? proba + (size_t)b * numClasses : nullptr,
+				top, classes ? classes + (size_t)b * top : nullptr, logProbabilities ? logProbabilities + (size_t)b * top : nullptr);
+		}
+	}
+}
+
+void NaiveBayes::scoreTile(const Model &model, const float *x, int rows, int *out, float *proba, int top, int *classes, float *logProbabilities) const {
+	// Reused by every call on the thread after its first
+	static thread_local std::vector<float> padded;
+	float scores[PREDICT_TILE * NUMCLASSES_MAX];
+
+	// Caller rows are only copied when they need zero padding
+	const float *input = x;
+	int ldx = numFeatures;
+
+	if (numFeatures != numFeaturesPadded) {
+		padded.resize(PREDICT_TILE * numFeaturesPadded);
+
+		for (int i = 0; i < rows; i++) {
+			std::copy(x + i * numFeatures, x + (i + 1) * numFeatures, padded.begin() + i * numFeaturesPadded);
+			std::fill(padded.begin() + i * numFeaturesPadded + numFeatures, padded.begin() + (i + 1) * numFeaturesPadded, 0.0f);
+		}
+
+		input = padded.data();
+		ldx = numFeaturesPadded;
+	}
+
+	kernels::score(input, ldx, rows, model.constants.data(), model.means.data(), model.coefficients.data(), numClasses, numFeaturesPadded, scores);
+
+	if (top) {
+		for (int i = 0; i < rows; i++) {
+			kernels::topk(scores + i * numClasses, numClasses, top, classes + i * top, logProbabilities + i * top);
+		}
+
+		return;
+	}
+
+	for (int i = 0; i < rows; i++) {
+		const float *score = scores + i * numClasses;
+		float max_likelihood = -INFINITY;
+		int prediction = 0;
+
+		for (int k = 0; k < numClasses; k++) {
+			if (score[k] > max_likelihood) {
+				max_likelihood = score[k];
+				prediction = k;
+			}
+		}
+
+		if (out) out[i] = prediction;
+
+		if (proba) {
+			// Normalize with log-sum-exp around the maximum
+			float sum = 0.0f;
+			for (int k = 0; k < numClasses; k++) {
+				sum += expf(score[k] - score[prediction]);
+			}
+
+			for (int k = 0; k < numClasses; k++) {
+				proba[i * numClasses + k] = expf(score[k] - score[prediction]) / sum;
+			}
+		}
+	}
 }
@@ -17,10 +17,42 @@
 #ifndef NAIVEBAYES_H
 #define NAIVEBAYES_H
 
+#include <cstdint>
+#include <future>
 #include <inaccel/coral>
+#include <memory>
+#include <ostream>
 #include <string>
 
+#include "Accelerator.h"
+#include "Dataset.h"
+#include "Dispatcher.h"
+#include "Gemm.h"
+#include "Model.h"
+#include "Quantized.h"
+#include "Reader.h"
+#include "Snapshot.h"
+#include "Statistics.h"
+
+// An accelerator request in flight. get waits for it and records its submit
+// to complete latency, so timing it takes no thread of its own.
+struct Request {
+	std::future<void> response;
+	uint64_t start;
+
+	void get();
+};
+
 class NaiveBayes {
+public:
+	// CPU scoring: fp32 tiled kernels, fp32 matrix products, or uint8 features
+	// against bf16/fp16 model parameters
+	enum Engine { TILED, GEMM, BF16, FP16 };
+
+	// Values of hw: CPU, accelerator, split between both by measured cost, or
+	// shared between both as they go
+	enum Device { SW, HW, AUTO, HYBRID };
+
 private:
 	int numClasses;
 	int numFeatures;
@@ -29,25 +61,152 @@ private:
 
 	std::vector<int> labels;
 	inaccel::vector<float> features;
-	inaccel::vector<float> priors;
-	inaccel::vector<float> means;
-	inaccel::vector<float> variances;
 	inaccel::vector<int> predictions;
 
-	void load_data(std::string filename, int numExamples);
+	// Trained model, reaching the classifications on the next compile
+	std::vector<float> priors;
+	std::vector<float> means;
+	std::vector<float> variances;
 
-	void classify(float epsilon, int hw);
+	// Padded features read by the CPU paths: features or the mapped dataset
+	const float *data;
+	Dataset dataset;
+
+	// uint8 codes of data for the BF16/FP16 engines, coded on first use
+	std::vector<uint8_t> codes;
+
+	std::shared_ptr<Accelerator> accelerator;
+	Dispatcher dispatcher;
+
+	// Accumulators of everything trained so far, extended by partial_fit
+	Statistics statistics;
+	std::vector<float> batch;
+
+	// Compiled model pinned by every classification for its whole duration,
+	// so a new one can be published while others are running
+	mutable SnapshotDomain snapshots;
+	bool stale;
+
+	Engine engine;
+	bool deterministic;
+
+	// Progress lines, on std::cout unless silenced
+	std::ostream console;
+
+	int read_csv(std::string filename, int numExamples);
+
+	std::future<int> stream(Reader &reader, int chunkRows, std::vector<int> &chunkLabels, std::vector<float> &chunkFeatures);
+
+	int parse(Reader &reader, int rows, int *labels, float *x);
+
+	void accumulate(Statistics &statistics, const float *x, const int *labels, int numExamples);
 
 	void classifySW(float epsilon);
 
+	void classifyCodes(const Quantized &quantized);
+
+	void classifyRows(const Snapshot &snapshot, Engine engine, const float *x, int numExamples, int *predictions);
+
+	void classifyBlock(const Snapshot &snapshot, Engine engine, const float *x, int rows, int *predictions, float *scores);
+
+	void argmax(const float *scores, int rows, int *predictions) const;
+
 	void classifyHW(float epsilon);
 
+	void classifyAuto(float epsilon);
+
+	void classifyHybrid(float epsilon);
+
+	void stage();
+
+	std::vector<Request> offload(Snapshot &snapshot, float epsilon, int requests, int requestRows);
+
+	Request submit(Snapshot &snapshot, inaccel::vector<float>::iterator x, inaccel::vector<int>::iterator predictions, float epsilon, int rows);
+
+	void streamSW(Reader &reader, float epsilon, int chunkRows, long long &cor, long long &total);
+
+	void streamHW(Reader &reader, float epsilon, int chunkRows, long long &cor, long long &total);
+
+	void publish(Snapshot *snapshot);
+
+	void score(const float *x, int n, int *out, float *proba, int top, int *classes, float *logProbabilities) const;
+
+	void scoreTile(const Model &model, const float *x, int rows, int *out, float *proba, int top, int *classes, float *logProbabilities) const;
+
 public:
 	NaiveBayes(int numClasses, int numFeatures, int threads);
 
+	void setEngine(Engine engine);
+
+	// Backend for HW classification, Coral by default
+	void setAccelerator(std::shared_ptr<Accelerator> accelerator);
+
+	// Reproduce the same model bits regardless of the number of threads
+	void setDeterministic(bool deterministic);
+
+	// Progress and accuracy lines on std::cout, on by default. Timings are
+	// recorded in metrics either way.
+	void setVerbose(bool verbose);
+
 	void train(std::string filename, int numExamples);
 
 	void predict(float epsilon, int hw);
+
+	// The phases of train and predict, for callers that time or check them on
+	// their own: load_data reads the examples of a file, fit trains on them and
+	// classify labels them on hw (a Device) into getPredictions()
+	void load_data(std::string filename, int numExamples);
+
+	void fit();
+
+	void classify(float epsilon, int hw);
+
+	const int *getPredictions() const;
+
+	// Copy of the compiled model, e.g. for a ModelSet or a SparseModel
+	Model getModel() const;
+
+	// Out-of-core variants: the file is read chunkRows examples at a time and
+	// only two chunks are held in memory
+	void trainStream(std::string filename, int chunkRows);
+
+	void predictStream(std::string filename, float epsilon, int hw, int chunkRows);
+
+	// Precomputes the model for epsilon and publishes it, once per train.
+	// Classifications already running finish on the model they started
+	// with, without locks, and the replaced model is freed after them.
+	void compile(float epsilon);
+
+	// Merges n labeled examples of numFeatures floats into the trained model
+	// in O(n), and recompiles it for the last compiled epsilon. Training,
+	// compile, partial_fit and load are called from one thread at a time,
+	// concurrently with any number of predict/predict_proba callers. Throws
+	// std::runtime_error, with the model unchanged, if a label is not a class
+	// in [0, numClasses).
+	void partial_fit(const float *x, const int *labels, int n);
+
+	// Persists the trained model, with its compiled form for the last
+	// compiled epsilon if compiled is set
+	void save(std::string filename, bool compiled) const;
+
+	// Replaces the trained model, and the compiled one if the file has it,
+	// so scoring can start without train. Without it scoring throws until
+	// the next compile.
+	void load(std::string filename);
+
+	// Low-latency scoring of n caller-owned examples of numFeatures floats with
+	// the compiled model: out[n] gets the classes, proba[n][numClasses] the
+	// posterior probabilities. Nothing is allocated after the first call on a
+	// thread, and batches of PREDICT_BATCH examples or more are spread over
+	// the CPU threads. Throws std::runtime_error if there is no compiled model.
+	void predict(const float *x, int n, int *out) const;
+
+	void predict_proba(const float *x, int n, float *proba) const;
+
+	// Top k classes of every example by decreasing posterior, classes[n][k],
+	// and their normalized log posteriors, logProbabilities[n][k], reduced
+	// from the scores as they are computed (k <= numClasses)
+	void predict_topk(const float *x, int n, int k, int *classes, float *logProbabilities) const;
 };
 
 #endif // NAIVEBAYES_H
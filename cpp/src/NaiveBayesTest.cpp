@@ -14,21 +14,374 @@
 * limitations under the License.
 */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <unistd.h>
+#include <vector>
 
+#include "Accelerator.h"
+#include "Dataset.h"
+#include "Dispatcher.h"
+#include "ModelSet.h"
 #include "NaiveBayes.h"
 
+#define CHECK_CLASSES 10 // Classes of the synthetic checks
+#define CHECK_FEATURES 100 // Features of the synthetic checks, not a multiple of 8
+#define CHECK_EXAMPLES 20011 // Examples of the synthetic checks
+#define CHECK_EPSILON 0.05f // Variance smoothing of the checks
+#define CHECK_TIE 1e-3f // Log posterior gap below which two engines may differ
+
+static int failures = 0;
+
+static void check(std::string name, bool passed) {
+	std::cout << " -- Check " << name << ": " << (passed ? "ok" : "FAILED") << "\n";
+	if (!passed) failures++;
+}
+
+// Labeled Gaussian examples, well apart per class, as unpadded rows
+struct Examples {
+	std::vector<int> labels;
+	std::vector<float> features;
+
+	Examples(int numExamples, unsigned seed) {
+		std::mt19937 random(seed);
+		std::normal_distribution<float> normal;
+
+		std::vector<float> means(CHECK_CLASSES * CHECK_FEATURES);
+		for (float &mean : means) mean = 2 * normal(random);
+
+		labels.resize(numExamples);
+		features.resize((size_t)numExamples * CHECK_FEATURES);
+
+		for (int i = 0; i < numExamples; i++) {
+			labels[i] = random() % CHECK_CLASSES;
+
+			for (int j = 0; j < CHECK_FEATURES; j++) {
+				features[(size_t)i * CHECK_FEATURES + j] = means[labels[i] * CHECK_FEATURES + j] + normal(random);
+			}
+		}
+	}
+
+	// Writes the examples as a dataset file for load_data
+	void write(std::string filename) const {
+		int numFeaturesPadded = (CHECK_FEATURES + 7) & ~7;
+		std::vector<float> padded((size_t)labels.size() * numFeaturesPadded, 0.0f);
+
+		for (size_t i = 0; i < labels.size(); i++) {
+			std::copy(&features[i * CHECK_FEATURES], &features[(i + 1) * CHECK_FEATURES], &padded[i * numFeaturesPadded]);
+		}
+
+		Dataset::write(filename, labels.data(), padded.data(), labels.size(), CHECK_FEATURES, numFeaturesPadded);
+	}
+};
+
+// Counts the predictions of other that differ from reference, except where
+// the two classes are within CHECK_TIE in the CPU posteriors
+static int differences(const NaiveBayes &nb, const Examples &examples, int n, const int *reference, const int *other) {
+	std::vector<float> proba(CHECK_CLASSES);
+	int different = 0;
+
+	for (int i = 0; i < n; i++) {
+		if (reference[i] == other[i]) continue;
+
+		nb.predict_proba(&examples.features[(size_t)i * CHECK_FEATURES], 1, proba.data());
+		if (other[i] < 0 || other[i] >= CHECK_CLASSES || fabsf(logf(proba[reference[i]]) - logf(proba[other[i]])) > CHECK_TIE) different++;
+	}
+
+	return different;
+}
+
+// Dispatcher that has seen a CPU cost of rowNs per example, and accelerator
+// costs of requestNs per request plus byteNs per byte
+static Dispatcher measured(double rowNs, double requestNs, double byteNs) {
+	Dispatcher dispatcher;
+
+	for (int n = 0; n < 100; n++) {
+		dispatcher.observeSW(1000, 1000 * rowNs);
+
+		int requests = 1 + n % 8;
+		double bytes = (n % 5) * 1e6;
+		dispatcher.observeHW(requests, bytes, requests * requestNs + bytes * byteNs);
+	}
+
+	return dispatcher;
+}
+
+static void checkDispatcher() {
+	const int rows = 100000;
+	const double rowBytes = 420, requestBytes = 8400;
+
+	// Slow accelerator calls: everything stays on the CPU
+	Dispatcher cpu = measured(10, 1e9, 1);
+	check("dispatcher keeps a cheap batch on the CPU", cpu.split(rows, rowBytes, requestBytes, 8, 4096, 8) == 0);
+
+	// Slow CPU: everything goes to the accelerator
+	Dispatcher hw = measured(1e5, 1e3, 0.01);
+	check("dispatcher sends an expensive batch to the accelerator", hw.split(rows, rowBytes, requestBytes, 8, 4096, 8) == rows);
+
+	// Comparable costs: a split on the granularity, no worse than its neighbours
+	// or either side alone
+	Dispatcher both = measured(100, 1e5, 0.5);
+	int h = both.split(rows, rowBytes, requestBytes, 8, 4096, 8);
+
+	auto makespan = [&](int h) {
+		int requests = Dispatcher::requests(h, 8, 4096);
+		return std::max(both.costSW(rows - h), h ? both.costHW(requests, h * rowBytes + requests * requestBytes) : 0.0);
+	};
+
+	bool balanced = h > 0 && h < rows && h % 8 == 0;
+	for (int other : {0, rows, h - 8, h + 8}) {
+		balanced = balanced && makespan(h) <= makespan(other) * (1 + 1e-9);
+	}
+
+	check("dispatcher balances comparable costs (" + std::to_string(h) + " of " + std::to_string(rows) + " on HW)", balanced);
+}
+
+// AUTO against SW, on the Emulator, as the dispatcher learns the costs
+static void checkAuto(const Examples &examples, std::string filename) {
+	NaiveBayes nb(CHECK_CLASSES, CHECK_FEATURES, 4);
+	nb.setVerbose(false);
+	nb.setAccelerator(std::make_shared<Emulator>());
+
+	nb.load_data(filename, examples.labels.size());
+	nb.fit();
+
+	int n = examples.labels.size();
+
+	nb.classify(CHECK_EPSILON, NaiveBayes::SW);
+	std::vector<int> reference(nb.getPredictions(), nb.getPredictions() + n);
+
+	bool same = true;
+	for (int hw : {NaiveBayes::HW, NaiveBayes::AUTO, NaiveBayes::AUTO, NaiveBayes::AUTO}) {
+		nb.classify(CHECK_EPSILON, hw);
+		same = same && !differences(nb, examples, n, reference.data(), nb.getPredictions());
+	}
+
+	check("AUTO matches SW on the Emulator", same);
+}
+
+// Predictions of a fresh classifier on the first n examples, so that none are
+// left over from another device
+static std::vector<int> predictions(std::string filename, int numExamples, int n, int hw) {
+	NaiveBayes nb(CHECK_CLASSES, CHECK_FEATURES, 4);
+	nb.setVerbose(false);
+	nb.setDeterministic(true);
+	nb.setAccelerator(std::make_shared<Emulator>());
+
+	nb.load_data(filename, numExamples);
+	nb.fit();
+
+	nb.load_data(filename, n);
+	nb.classify(CHECK_EPSILON, hw);
+
+	return std::vector<int>(nb.getPredictions(), nb.getPredictions() + n);
+}
+
+// HW and HYBRID against SW on the Emulator, for batches that are not multiples
+// of the kernel vectorization or of the hybrid chunks
+static void checkHybrid(const Examples &examples, std::string filename) {
+	int numExamples = examples.labels.size();
+
+	NaiveBayes nb(CHECK_CLASSES, CHECK_FEATURES, 4);
+	nb.setVerbose(false);
+	nb.setDeterministic(true);
+
+	nb.load_data(filename, numExamples);
+	nb.fit();
+	nb.classify(CHECK_EPSILON, NaiveBayes::SW);
+	std::vector<int> reference(nb.getPredictions(), nb.getPredictions() + numExamples);
+
+	for (int n : {1, 7, 13, 100, 1029, 5003, numExamples}) {
+		bool same = true;
+		for (int hw : {NaiveBayes::HW, NaiveBayes::HYBRID}) {
+			same = same && !differences(nb, examples, n, reference.data(), predictions(filename, numExamples, n, hw).data());
+		}
+
+		check("HW and HYBRID match SW on " + std::to_string(n) + " examples", same);
+	}
+}
+
+// partial_fit from a first batch without class 0, which must never be
+// predicted until a later batch brings examples of it
+static void checkPartialFit(const Examples &examples) {
+	int n = examples.labels.size();
+
+	std::vector<int> labels;
+	std::vector<float> features;
+	for (int i = 0; i < n / 2; i++) {
+		if (!examples.labels[i]) continue;
+
+		labels.push_back(examples.labels[i]);
+		features.insert(features.end(), &examples.features[(size_t)i * CHECK_FEATURES], &examples.features[(size_t)(i + 1) * CHECK_FEATURES]);
+	}
+
+	NaiveBayes nb(CHECK_CLASSES, CHECK_FEATURES, 4);
+	nb.setVerbose(false);
+
+	nb.partial_fit(features.data(), labels.data(), labels.size());
+	nb.compile(CHECK_EPSILON);
+
+	std::vector<int> out(n);
+	std::vector<float> proba((size_t)n * CHECK_CLASSES);
+	nb.predict(examples.features.data(), n, out.data());
+	nb.predict_proba(examples.features.data(), n, proba.data());
+
+	bool finite = true;
+	int zeros = 0, correct = 0, seen = 0;
+	for (int i = 0; i < n; i++) {
+		for (int k = 0; k < CHECK_CLASSES; k++) {
+			finite = finite && std::isfinite(proba[(size_t)i * CHECK_CLASSES + k]);
+		}
+
+		if (!out[i]) zeros++;
+		if (examples.labels[i]) {
+			seen++;
+			if (out[i] == examples.labels[i]) correct++;
+		}
+	}
+
+	check("partial_fit without class 0 keeps finite probabilities", finite);
+	check("partial_fit without class 0 never predicts it", !zeros && correct > 0.9 * seen);
+
+	// All the classes ranked: class 0 last at -inf, the others finite
+	std::vector<int> classes((size_t)n * CHECK_CLASSES);
+	std::vector<float> logProbabilities((size_t)n * CHECK_CLASSES);
+	nb.predict_topk(examples.features.data(), n, CHECK_CLASSES, classes.data(), logProbabilities.data());
+
+	bool ranked = true;
+	for (int i = 0; i < n; i++) {
+		const int *top = &classes[(size_t)i * CHECK_CLASSES];
+		const float *logProbability = &logProbabilities[(size_t)i * CHECK_CLASSES];
+
+		ranked = ranked && top[0] == out[i] && top[CHECK_CLASSES - 1] == 0 && logProbability[CHECK_CLASSES - 1] == -INFINITY;
+		for (int k = 0; k < CHECK_CLASSES - 1; k++) {
+			ranked = ranked && std::isfinite(logProbability[k]) && logProbability[k] <= 0.0f;
+		}
+	}
+
+	check("partial_fit without class 0 ranks it last in predict_topk", ranked);
+
+	nb.partial_fit(&examples.features[(size_t)(n / 2) * CHECK_FEATURES], &examples.labels[n / 2], n - n / 2);
+	nb.predict(examples.features.data(), n, out.data());
+
+	int zeroCorrect = 0, zeroSeen = 0;
+	for (int i = 0; i < n; i++) {
+		if (examples.labels[i]) continue;
+
+		zeroSeen++;
+		if (!out[i]) zeroCorrect++;
+	}
+
+	check("partial_fit predicts class 0 once it has examples", zeroCorrect > 0.9 * zeroSeen);
+
+	// A label out of range is rejected before it reaches the accumulators
+	int rejected = 0;
+	for (int label : {-1, CHECK_CLASSES}) {
+		try {
+			nb.partial_fit(examples.features.data(), &label, 1);
+		} catch (std::runtime_error &) {
+			rejected++;
+		}
+	}
+
+	check("partial_fit rejects labels out of range", rejected == 2);
+}
+
+// ModelSet::classify against the predict of each of its models, which have
+// different class counts: all the classes, 4 with the last one empty, and 1
+static void checkModelSet(const Examples &examples) {
+	int n = examples.labels.size();
+	int numFeaturesPadded = (CHECK_FEATURES + 7) & ~7;
+
+	std::vector<std::unique_ptr<NaiveBayes>> models;
+	ModelSet set(CHECK_FEATURES, numFeaturesPadded);
+
+	// Classes of every model, and how many of them have examples
+	const int shapes[][2] = {{CHECK_CLASSES, CHECK_CLASSES}, {4, 3}, {1, 1}};
+
+	for (const int *shape : shapes) {
+		int classes = shape[0];
+
+		std::vector<int> labels(n);
+		for (int i = 0; i < n; i++) labels[i] = examples.labels[i] % shape[1];
+
+		models.emplace_back(new NaiveBayes(classes, CHECK_FEATURES, 4));
+		models.back()->setVerbose(false);
+		models.back()->partial_fit(examples.features.data(), labels.data(), n);
+		models.back()->compile(CHECK_EPSILON);
+
+		set.add(models.back()->getModel());
+	}
+
+	std::vector<float> padded((size_t)n * numFeaturesPadded, 0.0f);
+	for (int i = 0; i < n; i++) {
+		std::copy(&examples.features[(size_t)i * CHECK_FEATURES], &examples.features[(size_t)(i + 1) * CHECK_FEATURES], &padded[(size_t)i * numFeaturesPadded]);
+	}
+
+	std::vector<int> predictions((size_t)n * set.size());
+	set.classify(padded.data(), n, predictions.data());
+
+	bool same = set.size() == (int)models.size();
+	std::vector<int> out(n);
+	for (int m = 0; m < set.size() && same; m++) {
+		models[m]->predict(examples.features.data(), n, out.data());
+
+		for (int i = 0; i < n; i++) {
+			same = same && predictions[(size_t)i * set.size() + m] == out[i];
+		}
+	}
+
+	check("ModelSet matches the predict of each model", same);
+}
+
+// Synthetic checks of the host paths, the accelerator emulated on the CPU
+static int checks() {
+	Examples examples(CHECK_EXAMPLES, 42);
+
+	char filename[] = "/tmp/NaiveBayesCheckXXXXXX";
+	int fd = mkstemp(filename);
+	if (fd < 0) {
+		std::cout << "Cannot create a temporary file\n";
+		return -1;
+	}
+	close(fd);
+
+	examples.write(filename);
+
+	checkDispatcher();
+	checkAuto(examples, filename);
+	checkHybrid(examples, filename);
+	checkPartialFit(examples);
+	checkModelSet(examples);
+
+	remove(filename);
+
+	std::cout << "\n -- " << failures << " checks failed\n\n";
+	return failures ? 1 : 0;
+}
+
 int main(int argc, const char *argv[]) {
-	if (argc != 3) {
-		std::cout << "Usage: ./" << argv[0] << " <CPU threads> <HW/SW, SW:0, HW:1>\n";
+	if (argc == 2 && !strcmp(argv[1], "check")) return checks();
+
+	if (argc != 3 && argc != 4) {
+		std::cout << "Usage: ./" << argv[0] << " <CPU threads> <HW/SW, SW:0, HW:1, AUTO:2, HYBRID:3> [SW engine, TILED:0, GEMM:1, BF16:2, FP16:3]\n";
+		std::cout << "       ./" << argv[0] << " check\n";
 		exit(-1);
 	}
 
 	const uint threads = std::atoi(argv[1]);
 	const uint hw = std::atoi(argv[2]);
+	const uint engine = (argc == 4) ? std::atoi(argv[3]) : 0;
 
 	NaiveBayes nb(26, 784, threads);
+	nb.setEngine((NaiveBayes::Engine)engine);
 
 	nb.train(std::string(std::getenv("HOME")) + "/data/letters_csv_train.dat", 124800);
 
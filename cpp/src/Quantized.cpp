@@ -0,0 +1,73 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "Quantized.h"
+
+#define LEVELS 255 // Largest uint8 code
+
+Quantized::Quantized(): numClasses(0), numFeatures(0), numFeaturesPadded(0), format(kernels::BF16) {}
+
+void Quantized::compile(const Model &model, const float *minimums, const float *maximums, kernels::Half format) {
+	numClasses = model.numClasses;
+	numFeatures = model.numFeatures;
+	numFeaturesPadded = model.numFeaturesPadded;
+	this->format = format;
+
+	scales.assign(numFeaturesPadded, 1.0f);
+	offsets.assign(numFeaturesPadded, 0.0f);
+
+	for (int j = 0; j < numFeatures; j++) {
+		if (!std::isfinite(minimums[j]) || !std::isfinite(maximums[j])) continue;
+
+		offsets[j] = minimums[j];
+		if (maximums[j] > minimums[j]) scales[j] = (maximums[j] - minimums[j]) / LEVELS;
+	}
+
+	constants.assign(model.constants.begin(), model.constants.begin() + numClasses);
+	means.resize((size_t)numClasses * numFeaturesPadded);
+	coefficients.resize((size_t)numClasses * numFeaturesPadded);
+
+	for (int k = 0; k < numClasses; k++) {
+		for (int j = 0; j < numFeaturesPadded; j++) {
+			size_t index = (size_t)k * numFeaturesPadded + j;
+
+			means[index] = kernels::half((model.means[index] - offsets[j]) / scales[j], format);
+			coefficients[index] = kernels::half(model.coefficients[index] * scales[j] * scales[j], format);
+		}
+	}
+}
+
+void Quantized::quantize(const float *x, int ldx, int rows, uint8_t *q) const {
+	for (int i = 0; i < rows; i++) {
+		const float *row = x + (size_t)i * ldx;
+		uint8_t *codes = q + (size_t)i * numFeaturesPadded;
+
+		#pragma omp simd
+		for (int j = 0; j < numFeatures; j++) {
+			float code = (row[j] - offsets[j]) / scales[j];
+			codes[j] = (uint8_t)std::min(std::max(code + 0.5f, 0.0f), (float)LEVELS);
+		}
+
+		std::fill(codes + numFeatures, codes + numFeaturesPadded, 0);
+	}
+}
+
+void Quantized::score(const uint8_t *q, int rows, float *scores) const {
+	kernels::score(q, numFeaturesPadded, rows, constants.data(), means.data(), coefficients.data(), format, numClasses, numFeaturesPadded, scores);
+}
@@ -0,0 +1,68 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef QUANTIZED_H
+#define QUANTIZED_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Kernels.h"
+#include "Model.h"
+
+/**
+* Reduced-precision form of a compiled Model.
+*
+* Features are coded as uint8 with a per-feature affine map,
+*   x[j] ~ offsets[j] + scales[j] * q[j]
+* spanning the range seen in training. The map folds into the model, as
+*   c * (x - m)^2 = (c * scale^2) * (q - (m - offset) / scale)^2
+* so the kernel scores the codes directly against means and coefficients
+* stored as bf16 or fp16, accumulating in fp32. The constants stay fp32.
+*
+* The codes take a quarter of the bytes of fp32 features, but scoring stays
+* bound by the conversions and FMAs rather than by memory: on 26 classes x
+* 784 features it runs at about the speed of the fp32 tiles, not faster.
+*/
+class Quantized {
+public:
+	int numClasses;
+	int numFeatures;
+	int numFeaturesPadded;
+
+	kernels::Half format;
+
+	std::vector<float> scales;
+	std::vector<float> offsets;
+
+	std::vector<float> constants;
+	std::vector<uint16_t> means;
+	std::vector<uint16_t> coefficients;
+
+	Quantized();
+
+	// minimums and maximums per padded feature; a feature without a range
+	// keeps its raw values, clamped to [0, 255]
+	void compile(const Model &model, const float *minimums, const float *maximums, kernels::Half format);
+
+	// q[rows][numFeaturesPadded] codes of rows of x spaced ldx floats apart
+	void quantize(const float *x, int ldx, int rows, uint8_t *q) const;
+
+	// scores[rows][numClasses] of rows of numFeaturesPadded codes
+	void score(const uint8_t *q, int rows, float *scores) const;
+};
+
+#endif // QUANTIZED_H
@@ -0,0 +1,50 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+
+#include "Reader.h"
+
+Reader::Reader(int numFeatures, int numFeaturesPadded): numFeatures(numFeatures), numFeaturesPadded(numFeaturesPadded), binary(false), position(0) {}
+
+void Reader::open(std::string filename) {
+	binary = Dataset::detect(filename);
+	position = 0;
+
+	if (binary) {
+		dataset.open(filename);
+		assert (dataset.numFeatures == numFeatures);
+		assert (dataset.numFeaturesPadded == numFeaturesPadded);
+	} else {
+		csv.open(filename);
+	}
+}
+
+int Reader::read(int rows, int *labels, float *features) {
+	if (!binary) return csv.read(rows, numFeatures, numFeaturesPadded, labels, features);
+
+	rows = std::min(rows, dataset.numExamples - position);
+
+	memcpy(labels, dataset.labels + position, rows * sizeof(int));
+	memcpy(features, dataset.features + (size_t)position * numFeaturesPadded, (size_t)rows * numFeaturesPadded * sizeof(float));
+
+	position += rows;
+	dataset.release(position);
+
+	return rows;
+}
@@ -0,0 +1,54 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef READER_H
+#define READER_H
+
+#include <string>
+
+#include "Csv.h"
+#include "Dataset.h"
+
+/**
+* Sequential chunk reader over a CSV or binary dataset file.
+*
+* Each read copies the next examples into a caller-owned chunk buffer and
+* drops the pages it consumed from the mapping, so memory use is bounded by
+* the chunk buffers rather than the file size.
+*/
+class Reader {
+private:
+	int numFeatures;
+	int numFeaturesPadded;
+
+	bool binary;
+	int position;
+
+	Csv csv;
+	Dataset dataset;
+
+public:
+	Reader(int numFeatures, int numFeaturesPadded);
+
+	// Throws std::runtime_error if the file cannot be opened
+	void open(std::string filename);
+
+	// Reads up to rows examples into labels[rows] and features[rows][numFeaturesPadded]
+	// and returns how many were read, 0 at the end of the file
+	int read(int rows, int *labels, float *features);
+};
+
+#endif // READER_H
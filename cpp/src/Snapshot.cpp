@@ -0,0 +1,120 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "Snapshot.h"
+
+SnapshotDomain::Pin::Pin(SnapshotDomain &domain): domain(domain), slot(-1) {
+	// Threads keep returning to the slot they used last, spreading out at first
+	static thread_local unsigned hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+	for (unsigned i = hint; i < hint + SNAPSHOT_READERS; i++) {
+		Slot &candidate = domain.slots[i % SNAPSHOT_READERS];
+		uint64_t free = 0;
+
+		// The epoch is recorded before the pointer is loaded, so a writer that
+		// misses this slot has already swapped the pointer
+		epoch = domain.epoch.load();
+		if (!candidate.epoch.load(std::memory_order_relaxed) && candidate.epoch.compare_exchange_strong(free, epoch)) {
+			slot = i % SNAPSHOT_READERS;
+			hint = slot;
+			break;
+		}
+	}
+
+	// Same order under the lock, which a writer takes to read the overflow
+	if (slot < 0) {
+		std::lock_guard<std::mutex> lock(domain.overflowLock);
+
+		epoch = domain.epoch.load();
+		domain.overflow.insert(epoch);
+	}
+
+	snapshot = domain.current.load();
+}
+
+SnapshotDomain::Pin::~Pin() {
+	if (slot >= 0) {
+		// Ordered before the load of pending, which a writer sets before its scan
+		domain.slots[slot].epoch.store(0);
+	} else {
+		std::lock_guard<std::mutex> lock(domain.overflowLock);
+
+		domain.overflow.erase(domain.overflow.find(epoch));
+	}
+
+	// Snapshots retired while readers held them are freed by the readers as
+	// they leave, not only at the next publish
+	if (domain.pending.load() && domain.retiredLock.try_lock()) {
+		domain.reclaim();
+		domain.retiredLock.unlock();
+	}
+}
+
+SnapshotDomain::SnapshotDomain(): current(nullptr), epoch(1), pending(false) {
+	for (int i = 0; i < SNAPSHOT_READERS; i++) {
+		slots[i].epoch.store(0, std::memory_order_relaxed);
+	}
+}
+
+SnapshotDomain::~SnapshotDomain() {
+	delete current.load();
+
+	for (auto &entry : retired) {
+		delete entry.first;
+	}
+}
+
+void SnapshotDomain::publish(Snapshot *snapshot) {
+	Snapshot *previous = current.exchange(snapshot);
+
+	std::lock_guard<std::mutex> lock(retiredLock);
+
+	// Readers that could have loaded previous recorded this epoch or an earlier one
+	if (previous) {
+		retired.push_back(std::make_pair(previous, epoch.fetch_add(1)));
+		pending.store(true);
+	}
+
+	reclaim();
+}
+
+void SnapshotDomain::reclaim() {
+	uint64_t oldest = UINT64_MAX;
+	for (int i = 0; i < SNAPSHOT_READERS; i++) {
+		uint64_t pinned = slots[i].epoch.load();
+		if (pinned) oldest = std::min(oldest, pinned);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(overflowLock);
+		if (!overflow.empty()) oldest = std::min(oldest, *overflow.begin());
+	}
+
+	auto drained = std::partition(retired.begin(), retired.end(), [oldest](const std::pair<Snapshot *, uint64_t> &entry) {
+		return entry.second >= oldest;
+	});
+
+	for (auto entry = drained; entry != retired.end(); entry++) {
+		delete entry->first;
+	}
+
+	retired.erase(drained, retired.end());
+	pending.store(!retired.empty());
+}
@@ -0,0 +1,117 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+#include <inaccel/coral>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "Gemm.h"
+#include "Model.h"
+#include "Quantized.h"
+
+#define SNAPSHOT_READERS 128 // Readers that can pin a snapshot at the same time without a lock
+
+/**
+* Everything a classification reads: the trained model in the accelerator
+* buffers, and its compiled CPU forms. Never modified once published.
+*/
+struct Snapshot {
+	inaccel::vector<float> priors;
+	inaccel::vector<float> means;
+	inaccel::vector<float> variances;
+
+	Model model;
+	Gemm gemm;
+	Quantized bf16;
+	Quantized fp16;
+};
+
+/**
+* Epoch based publication of snapshots (RCU).
+*
+* A reader pins the current snapshot by recording the global epoch in a free
+* slot and then loading the pointer, both lock-free. When all slots are taken
+* the epoch is recorded under a lock in an overflow set instead. Publishing
+* swaps the pointer, retires the old snapshot at the current epoch and
+* advances it; a retired snapshot is deleted once every pinned slot and
+* overflow reader holds a later epoch, so it is no longer reachable by any
+* reader. Both publishing and the last reader of a retired snapshot delete
+* it. Publishing happens from one thread at a time.
+*/
+class SnapshotDomain {
+private:
+	struct Slot {
+		std::atomic<uint64_t> epoch; // 0 when free
+		char padding[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	std::atomic<Snapshot *> current;
+	std::atomic<uint64_t> epoch;
+	Slot slots[SNAPSHOT_READERS];
+
+	std::vector<std::pair<Snapshot *, uint64_t>> retired;
+	std::atomic<bool> pending; // Whether retired is not empty
+	std::mutex retiredLock;
+
+	std::multiset<uint64_t> overflow; // Epochs of the readers without a slot
+	std::mutex overflowLock;
+
+	// Deletes the retired snapshots no reader can reach, retiredLock held
+	void reclaim();
+
+public:
+	// Keeps the snapshot current at construction alive until destruction
+	class Pin {
+	private:
+		SnapshotDomain &domain;
+		int slot; // -1 in overflow
+		uint64_t epoch;
+		Snapshot *snapshot;
+
+	public:
+		Pin(SnapshotDomain &domain);
+
+		~Pin();
+
+		Pin(const Pin &) = delete;
+
+		Pin &operator=(const Pin &) = delete;
+
+		Snapshot *get() const {
+			return snapshot;
+		}
+
+		Snapshot *operator->() const {
+			return snapshot;
+		}
+	};
+
+	SnapshotDomain();
+
+	~SnapshotDomain();
+
+	// Takes ownership of snapshot and makes it current
+	void publish(Snapshot *snapshot);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,97 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+
+#include "Metrics.h"
+#include "SparseModel.h"
+
+#define BLOCK 64 // Examples scored together by a CPU thread
+
+SparseModel::SparseModel(): numClasses(0), numFeatures(0) {}
+
+void SparseModel::compile(const Model &model) {
+	numClasses = model.numClasses;
+	numFeatures = model.numFeatures;
+
+	base.assign(numClasses, 0.0f);
+	coefficients.assign((size_t)numFeatures * numClasses, 0.0f);
+	shifts.assign((size_t)numFeatures * numClasses, 0.0f);
+
+	for (int k = 0; k < numClasses; k++) {
+		double score = model.constants[k];
+
+		for (int j = 0; j < numFeatures; j++) {
+			size_t index = (size_t)k * model.numFeaturesPadded + j;
+			double mean = model.means[index];
+
+			score += model.coefficients[index] * mean * mean;
+
+			coefficients[(size_t)j * numClasses + k] = model.coefficients[index];
+			shifts[(size_t)j * numClasses + k] = -2 * mean;
+		}
+
+		base[k] = score;
+	}
+}
+
+void SparseModel::score(const Csr &csr, int begin, int rows, float *scores) const {
+	for (int i = 0; i < rows; i++) {
+		float *__restrict score = scores + (size_t)i * numClasses;
+		std::copy(base.begin(), base.end(), score);
+
+		for (long long p = csr.offsets[begin + i]; p < csr.offsets[begin + i + 1]; p++) {
+			float x = csr.values[p];
+			const float *__restrict coefficient = &coefficients[(size_t)csr.indices[p] * numClasses];
+			const float *__restrict shift = &shifts[(size_t)csr.indices[p] * numClasses];
+
+			#pragma omp simd
+			for (int k = 0; k < numClasses; k++) {
+				score[k] += coefficient[k] * x * (x + shift[k]);
+			}
+		}
+	}
+}
+
+void SparseModel::classify(const Csr &csr, int *predictions) const {
+	int numExamples = csr.rows();
+
+	#pragma omp parallel
+	{
+		std::vector<float> scores(BLOCK * numClasses);
+
+		#pragma omp for schedule(dynamic)
+		for (int b = 0; b < numExamples; b += BLOCK) {
+			int rows = std::min(BLOCK, numExamples - b);
+
+			metrics::Scope timer(metrics::CLASSIFY_BLOCK);
+			metrics::add(metrics::ROWS_CLASSIFIED, rows);
+
+			score(csr, b, rows, scores.data());
+
+			for (int i = 0; i < rows; i++) {
+				const float *score = &scores[i * numClasses];
+				int prediction = 0;
+
+				for (int k = 1; k < numClasses; k++) {
+					if (score[k] > score[prediction]) prediction = k;
+				}
+
+				predictions[b + i] = prediction;
+			}
+		}
+	}
+}
@@ -0,0 +1,55 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef SPARSEMODEL_H
+#define SPARSEMODEL_H
+
+#include <vector>
+
+#include "Csr.h"
+#include "Model.h"
+
+/**
+* Compiled model for CSR examples.
+*
+* Expanding coefficients[k][j] * (x[j] - means[k][j])^2 gives
+*   base[k] + sum over the nonzeros of coefficients[k][j] * x[j] * (x[j] - 2 * means[k][j])
+* where base[k] is the score of the all-zero example, so an example costs
+* its nonzeros times numClasses. The per-feature terms are stored
+* [numFeatures][numClasses] so every nonzero updates all classes with
+* contiguous loads.
+*/
+class SparseModel {
+private:
+	int numClasses;
+	int numFeatures;
+
+	std::vector<float> base;
+	std::vector<float> coefficients;
+	std::vector<float> shifts; // -2 * means
+
+public:
+	SparseModel();
+
+	void compile(const Model &model);
+
+	// scores[rows][numClasses] for the examples [begin, begin + rows) of csr
+	void score(const Csr &csr, int begin, int rows, float *scores) const;
+
+	void classify(const Csr &csr, int *predictions) const;
+};
+
+#endif // SPARSEMODEL_H
@@ -0,0 +1,134 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <omp.h>
+#include <stdexcept>
+#include <string>
+
+#include "Metrics.h"
+#include "SparseNaiveBayes.h"
+#include "Statistics.h"
+
+#define NUMCLASSES_MAX 64 // Max number of model classes
+
+SparseNaiveBayes::SparseNaiveBayes(int numClasses, int numFeatures, int threads): numClasses(numClasses), numFeatures(numFeatures), csr(numFeatures), console(std::cout.rdbuf()) {
+	assert (numClasses <= NUMCLASSES_MAX);
+
+	omp_set_num_threads(threads);
+
+	priors.resize(numClasses);
+	means.resize((size_t)numClasses * numFeatures);
+	variances.resize((size_t)numClasses * numFeatures);
+
+	console << std::fixed;
+	console << std::setprecision(2);
+}
+
+void SparseNaiveBayes::setVerbose(bool verbose) {
+	console.rdbuf(verbose ? std::cout.rdbuf() : nullptr);
+}
+
+void SparseNaiveBayes::train(std::string filename, int numExamples) {
+	console << "\n -- Reading Input File " << std::flush;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	{
+		metrics::Scope timer(metrics::PARSE);
+		csr.read(filename, numExamples);
+	}
+
+	// Labels index the per-class accumulators, LIBSVM files may use -1/+1
+	for (int label : csr.labels) {
+		if (label < 0 || label >= numClasses) throw std::runtime_error("Label " + std::to_string(label) + " out of range in " + filename);
+	}
+
+	metrics::add(metrics::ROWS_PARSED, csr.rows());
+	metrics::add(metrics::BYTES_PARSED, csr.values.size() * (sizeof(float) + sizeof(int)));
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	float seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
+	console << "took: " << seconds << "s (" << csr.values.size() << " nonzeros)\n";
+
+	console << "\n -- Training " << std::flush;
+
+	start = std::chrono::high_resolution_clock::now();
+
+	// Rows are unpadded; accumulate spreads them over the threads
+	Statistics statistics(numClasses, numFeatures, numFeatures);
+	{
+		metrics::Scope timer(metrics::ACCUMULATE);
+		statistics.accumulate(csr.offsets.data(), csr.indices.data(), csr.values.data(), csr.labels.data(), csr.rows());
+	}
+
+	metrics::add(metrics::ROWS_TRAINED, csr.rows());
+
+	{
+		metrics::Scope timer(metrics::FINALIZE);
+		statistics.finalize(priors.data(), means.data(), variances.data());
+	}
+
+	model = Model();
+
+	end = std::chrono::high_resolution_clock::now();
+
+	seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
+	console << "took: " << seconds << "s\n";
+}
+
+void SparseNaiveBayes::compile(float epsilon) {
+	if (model.epsilon == epsilon) return;
+
+	metrics::Scope timer(metrics::COMPILE);
+
+	model.compile(numClasses, numFeatures, numFeatures, priors.data(), means.data(), variances.data(), epsilon);
+	sparse.compile(model);
+}
+
+void SparseNaiveBayes::classify(const Csr &examples, int *predictions) {
+	assert (examples.numFeatures == numFeatures);
+
+	sparse.classify(examples, predictions);
+}
+
+void SparseNaiveBayes::predict(float epsilon) {
+	console << "\n -- Classification " << std::flush;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	compile(epsilon);
+
+	std::vector<int> predictions(csr.rows());
+	classify(csr, predictions.data());
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	float seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0f;
+	console << "took: " << seconds << "s\n";
+
+	int cor = 0;
+	for (int i = 0; i < csr.rows(); i++) {
+		if (predictions[i] == csr.labels[i]) cor++;
+	}
+
+	console << "\n -- Accuracy: " << (100 * (float)(cor) / csr.rows()) << " % (" << cor << "/" << csr.rows() << ")\n\n";
+}
@@ -0,0 +1,68 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef SPARSENAIVEBAYES_H
+#define SPARSENAIVEBAYES_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Csr.h"
+#include "Model.h"
+#include "SparseModel.h"
+
+/**
+* NaiveBayes over CSR examples, for mostly-zero data. Training and scoring
+* cost is proportional to the nonzeros, and numFeatures is not capped by
+* NUMFEATURES_MAX since nothing is laid out densely per example.
+*/
+class SparseNaiveBayes {
+private:
+	int numClasses;
+	int numFeatures;
+
+	Csr csr;
+
+	std::vector<float> priors;
+	std::vector<float> means;
+	std::vector<float> variances;
+
+	Model model;
+	SparseModel sparse;
+
+	// Progress lines, on std::cout unless silenced
+	std::ostream console;
+
+public:
+	SparseNaiveBayes(int numClasses, int numFeatures, int threads);
+
+	// Progress and accuracy lines on std::cout, on by default
+	void setVerbose(bool verbose);
+
+	// Reads a LIBSVM or dense file into CSR and trains on it, on all the
+	// threads. Throws std::runtime_error if a label is not a class in
+	// [0, numClasses).
+	void train(std::string filename, int numExamples);
+
+	void predict(float epsilon);
+
+	void compile(float epsilon);
+
+	void classify(const Csr &examples, int *predictions);
+};
+
+#endif // SPARSENAIVEBAYES_H
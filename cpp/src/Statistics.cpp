@@ -0,0 +1,284 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+#include "Statistics.h"
+
+Statistics::Statistics(int numClasses, int numFeatures, int numFeaturesPadded): numClasses(numClasses), numFeatures(numFeatures), numFeaturesPadded(numFeaturesPadded) {
+	counts.assign(numClasses, 0);
+	means.assign(numClasses * numFeaturesPadded, 0.0);
+	m2.assign(numClasses * numFeaturesPadded, 0.0);
+
+	minimums.assign(numFeaturesPadded, INFINITY);
+	maximums.assign(numFeaturesPadded, -INFINITY);
+}
+
+void Statistics::accumulate(const float *x, const int *labels, int rows) {
+	batchCounts.assign(numClasses, 0);
+	shifts.resize(numClasses * numFeaturesPadded);
+	sums.assign(numClasses * numFeaturesPadded, 0.0);
+	squares.assign(numClasses * numFeaturesPadded, 0.0);
+
+	for (int i = 0; i < rows; i++) {
+		int label = labels[i];
+		const float *__restrict data = x + i * numFeaturesPadded;
+		double *__restrict shift = &shifts[label * numFeaturesPadded];
+		double *__restrict sum = &sums[label * numFeaturesPadded];
+		double *__restrict square = &squares[label * numFeaturesPadded];
+		float *__restrict minimum = minimums.data();
+		float *__restrict maximum = maximums.data();
+
+		// Shift by the running mean, or by the first example of a new class,
+		// so the sums stay small and E[x^2] - E[x]^2 does not cancel
+		if (!batchCounts[label]) {
+			if (counts[label]) std::copy(&means[label * numFeaturesPadded], &means[(label + 1) * numFeaturesPadded], shift);
+			else std::copy(data, data + numFeaturesPadded, shift);
+		}
+		batchCounts[label]++;
+
+		#pragma omp simd
+		for (int j = 0; j < numFeaturesPadded; j++) {
+			double difference = data[j] - shift[j];
+			sum[j] += difference;
+			square[j] += difference * difference;
+			minimum[j] = std::min(minimum[j], data[j]);
+			maximum[j] = std::max(maximum[j], data[j]);
+		}
+	}
+
+	fold();
+}
+
+// Mean and M2 of one class over a block of CSR examples, kept only for the
+// features the block set: every other feature was zero throughout, which
+// gives a mean and M2 of zero
+struct SparsePartial {
+	long long count = 0;
+	std::vector<int> features;
+	std::vector<double> means;
+	std::vector<double> m2;
+};
+
+void Statistics::accumulate(const long long *offsets, const int *indices, const float *values, const int *labels, int rows) {
+	int threads = omp_get_max_threads();
+	std::vector<std::vector<SparsePartial>> partials(threads, std::vector<SparsePartial>(numClasses));
+
+	#pragma omp parallel
+	{
+		int t = omp_get_thread_num();
+		int n = omp_get_num_threads();
+		int first = (long long)rows * t / n;
+		int last = (long long)rows * (t + 1) / n;
+
+		// Scratch of one class at a time, reset through the features it set
+		static thread_local std::vector<double> sum, square;
+		static thread_local std::vector<int> nonzero, set, touched, order, starts;
+		sum.assign(numFeaturesPadded, 0.0);
+		square.assign(numFeaturesPadded, 0.0);
+		nonzero.assign(numFeaturesPadded, 0);
+		set.assign(numFeaturesPadded, 0);
+		std::vector<float> minimum(numFeaturesPadded, INFINITY), maximum(numFeaturesPadded, -INFINITY);
+
+		// Rows of the block grouped by class
+		starts.assign(numClasses + 1, 0);
+		for (int i = first; i < last; i++) starts[labels[i] + 1]++;
+		for (int k = 0; k < numClasses; k++) starts[k + 1] += starts[k];
+		order.resize(last - first);
+		touched.clear();
+		{
+			std::vector<int> next(starts.begin(), starts.end() - 1);
+			for (int i = first; i < last; i++) order[next[labels[i]]++] = i;
+		}
+
+		for (int k = 0; k < numClasses; k++) {
+			long long count = starts[k + 1] - starts[k];
+			if (!count) continue;
+
+			// Shift by the running mean, or by zero for a new class since most of
+			// its features are implicit zeros
+			const double *shift = counts[k] ? &means[k * numFeaturesPadded] : nullptr;
+
+			for (int r = starts[k]; r < starts[k + 1]; r++) {
+				int i = order[r];
+
+				for (long long p = offsets[i]; p < offsets[i + 1]; p++) {
+					int j = indices[p];
+					double difference = values[p] - (shift ? shift[j] : 0.0);
+					if (!nonzero[j]++) touched.push_back(j);
+					sum[j] += difference;
+					square[j] += difference * difference;
+					set[j]++;
+
+					minimum[j] = std::min(minimum[j], values[p]);
+					maximum[j] = std::max(maximum[j], values[p]);
+				}
+			}
+
+			SparsePartial &partial = partials[t][k];
+			partial.count = count;
+
+			for (int j : touched) {
+				double offset = shift ? shift[j] : 0.0;
+				double zeros = count - nonzero[j];
+				double total = sum[j] - zeros * offset;
+				double mean = total / count;
+
+				partial.features.push_back(j);
+				partial.means.push_back(offset + mean);
+				partial.m2.push_back(std::max(square[j] + zeros * offset * offset - total * mean, 0.0));
+
+				sum[j] = square[j] = 0.0;
+				nonzero[j] = 0;
+			}
+			touched.clear();
+		}
+
+		// Features that were not set in every example of the block have seen a zero
+		for (int j = 0; j < numFeaturesPadded; j++) {
+			if (set[j] < last - first) {
+				minimum[j] = std::min(minimum[j], 0.0f);
+				maximum[j] = std::max(maximum[j], 0.0f);
+			}
+		}
+
+		#pragma omp critical
+		for (int j = 0; j < numFeaturesPadded; j++) {
+			minimums[j] = std::min(minimums[j], minimum[j]);
+			maximums[j] = std::max(maximums[j], maximum[j]);
+		}
+	}
+
+	// Each class merges its partials in thread order, densified one at a time
+	#pragma omp parallel for schedule(dynamic)
+	for (int k = 0; k < numClasses; k++) {
+		static thread_local std::vector<double> mean, m2;
+		mean.assign(numFeaturesPadded, 0.0);
+		m2.assign(numFeaturesPadded, 0.0);
+
+		for (int t = 0; t < threads; t++) {
+			const SparsePartial &partial = partials[t][k];
+			if (!partial.count) continue;
+
+			for (size_t f = 0; f < partial.features.size(); f++) {
+				mean[partial.features[f]] = partial.means[f];
+				m2[partial.features[f]] = partial.m2[f];
+			}
+
+			merge(k, partial.count, mean.data(), m2.data());
+
+			for (int j : partial.features) mean[j] = m2[j] = 0.0;
+		}
+	}
+}
+
+// Merges the shifted sums of the batch
+void Statistics::fold() {
+	for (int k = 0; k < numClasses; k++) {
+		long long count = batchCounts[k];
+		if (!count) continue;
+
+		double *shift = &shifts[k * numFeaturesPadded];
+		double *sum = &sums[k * numFeaturesPadded];
+		double *square = &squares[k * numFeaturesPadded];
+
+		// Batch mean and M2 in place of the shifted sums
+		for (int j = 0; j < numFeaturesPadded; j++) {
+			double mean = sum[j] / count;
+			square[j] = std::max(square[j] - sum[j] * mean, 0.0);
+			sum[j] = shift[j] + mean;
+		}
+
+		merge(k, count, sum, square);
+	}
+}
+
+void Statistics::merge(int k, long long count, const double *mean, const double *m2) {
+	long long total = counts[k] + count;
+	double weight = (double)count / total;
+	double cross = (double)counts[k] * weight;
+
+	double *__restrict means = &this->means[k * numFeaturesPadded];
+	double *__restrict m2s = &this->m2[k * numFeaturesPadded];
+
+	#pragma omp simd
+	for (int j = 0; j < numFeaturesPadded; j++) {
+		double delta = mean[j] - means[j];
+		means[j] += delta * weight;
+		m2s[j] += m2[j] + delta * delta * cross;
+	}
+
+	counts[k] = total;
+}
+
+void Statistics::merge(const Statistics &other) {
+	for (int k = 0; k < numClasses; k++) {
+		if (other.counts[k]) merge(k, other.counts[k], &other.means[k * numFeaturesPadded], &other.m2[k * numFeaturesPadded]);
+	}
+
+	for (int j = 0; j < numFeaturesPadded; j++) {
+		minimums[j] = std::min(minimums[j], other.minimums[j]);
+		maximums[j] = std::max(maximums[j], other.maximums[j]);
+	}
+}
+
+void Statistics::finalize(float *priors, float *means, float *variances) const {
+	for (int k = 0; k < numClasses; k++) {
+		priors[k] = counts[k] / (float)numFeatures;
+
+		for (int j = 0; j < numFeatures; j++) {
+			int index = k * numFeaturesPadded + j;
+
+			means[index] = this->means[index];
+			variances[index] = counts[k] ? m2[index] / counts[k] : 0.0f;
+		}
+	}
+}
+
+void Statistics::restore(const float *priors, const float *means, const float *variances) {
+	minimums.assign(numFeaturesPadded, INFINITY);
+	maximums.assign(numFeaturesPadded, -INFINITY);
+
+	for (int k = 0; k < numClasses; k++) {
+		counts[k] = llround(priors[k] * (double)numFeatures);
+
+		for (int j = 0; j < numFeatures; j++) {
+			int index = k * numFeaturesPadded + j;
+
+			this->means[index] = means[index];
+			m2[index] = (double)variances[index] * counts[k];
+
+			if (counts[k]) {
+				float deviation = 4 * sqrtf(variances[index]);
+				minimums[j] = std::min(minimums[j], means[index] - deviation);
+				maximums[j] = std::max(maximums[j], means[index] + deviation);
+			}
+		}
+	}
+}
+
+void Statistics::reduce(std::vector<Statistics> &partials) {
+	int n = partials.size();
+
+	for (int stride = 1; stride < n; stride *= 2) {
+		#pragma omp parallel for
+		for (int i = 0; i < n - stride; i += 2 * stride) {
+			partials[i].merge(partials[i + stride]);
+		}
+	}
+}
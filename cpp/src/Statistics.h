@@ -0,0 +1,83 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <vector>
+
+/**
+* Mergeable per-class training accumulators.
+*
+* Each (class, feature) keeps count, mean and M2 (sum of squared deviations)
+* in double, as a Welford accumulator that is updated a batch at a time: the
+* batch is summed relative to a per-class shift, then folded in with Chan's
+* pairwise formula. The same formula merges partials gathered independently
+* (per thread or per block of examples), so training is a parallel reduction
+* and the variance never goes negative. Arrays are laid out
+* [numClasses][numFeaturesPadded] like the model.
+*/
+class Statistics {
+public:
+	int numClasses;
+	int numFeatures;
+	int numFeaturesPadded;
+
+	std::vector<long long> counts;
+	std::vector<double> means;
+	std::vector<double> m2;
+
+	// Range of every feature over all the examples, for quantization
+	std::vector<float> minimums;
+	std::vector<float> maximums;
+
+private:
+	// Per-batch scratch of accumulate
+	std::vector<long long> batchCounts;
+	std::vector<double> shifts;
+	std::vector<double> sums;
+	std::vector<double> squares;
+
+	void fold();
+
+	void merge(int k, long long count, const double *mean, const double *m2);
+
+public:
+	Statistics(int numClasses, int numFeatures, int numFeaturesPadded);
+
+	// Adds examples of numFeaturesPadded floats each
+	void accumulate(const float *x, const int *labels, int rows);
+
+	// Adds CSR examples, the nonzeros of example i at [offsets[i], offsets[i + 1])
+	// of indices and values, on all the threads. Each thread keeps per class
+	// only the features its rows set, and the zeros are accounted for when
+	// the partials are merged, so the scratch follows the nonzeros rather than
+	// threads * numClasses * numFeatures
+	void accumulate(const long long *offsets, const int *indices, const float *values, const int *labels, int rows);
+
+	void merge(const Statistics &other);
+
+	void finalize(float *priors, float *means, float *variances) const;
+
+	// Inverse of finalize, for a model whose accumulators were not kept; the
+	// ranges become mean +/- 4 standard deviations over the classes
+	void restore(const float *priors, const float *means, const float *variances);
+
+	// Pairwise tree reduction into partials[0], in an order fixed by the partials count
+	static void reduce(std::vector<Statistics> &partials);
+};
+
+#endif // STATISTICS_H
@@ -0,0 +1,268 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Csr.h"
+#include "Dataset.h"
+#include "Kernels.h"
+#include "ModelSet.h"
+#include "NaiveBayes.h"
+#include "SparseModel.h"
+#include "Synthetic.h"
+
+#define VECTORIZATION 8 // Vectorization of features in HW
+#define REPETITIONS 10 // Timed runs of every benchmark, after one warm-up run
+#define EPSILON 0.05f // Variance smoothing of the classification benchmarks
+#define SEED 42 // Seed of the synthetic dataset
+#define TOPK 5 // Classes kept by the top-k benchmark
+#define MODELS 4 // Models scored together by the ModelSet benchmark
+
+/**
+* Runs every benchmark once to warm up and then REPETITIONS times, and reports
+* the median with the mean, standard deviation and minimum of the runs.
+* Throughput figures are taken from the median: bytes are what one run reads
+* from memory or disk.
+*/
+class Benchmark {
+private:
+	struct Result {
+		std::string name;
+		long long rows;
+		double bytes;
+		std::vector<double> ns;
+
+		double median() const {
+			std::vector<double> sorted(ns);
+			std::sort(sorted.begin(), sorted.end());
+			size_t n = sorted.size();
+			return (n % 2) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+		}
+
+		double mean() const {
+			double sum = 0;
+			for (double t : ns) sum += t;
+			return sum / ns.size();
+		}
+
+		double stddev() const {
+			if (ns.size() < 2) return 0;
+
+			double average = mean(), sum = 0;
+			for (double t : ns) sum += (t - average) * (t - average);
+			return sqrt(sum / (ns.size() - 1));
+		}
+
+		double min() const {
+			return *std::min_element(ns.begin(), ns.end());
+		}
+	};
+
+	int threads;
+	int repetitions;
+	std::vector<Result> results;
+
+	void run(std::string name, long long rows, double bytes, std::function<void()> f) {
+		Result result = {name, rows, bytes, {}};
+
+		f();
+		for (int r = 0; r < repetitions; r++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			f();
+			auto end = std::chrono::high_resolution_clock::now();
+
+			result.ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		}
+
+		double median = result.median();
+		std::cout << " -- " << std::left << std::setw(24) << name << std::right
+			<< std::setw(12) << median / rows << " ns/row"
+			<< std::setw(14) << rows / median * 1e9 << " rows/s"
+			<< std::setw(10) << bytes / median << " GB/s"
+			<< "  (+-" << 100 * result.stddev() / result.mean() << "%)\n";
+
+		results.push_back(result);
+	}
+
+public:
+	Benchmark(int threads, int repetitions): threads(threads), repetitions(repetitions) {}
+
+	void suite(const Synthetic &synthetic, bool hw) {
+		int n = synthetic.numExamples;
+		int numClasses = synthetic.numClasses;
+		int numFeatures = synthetic.numFeatures;
+		int numFeaturesPadded = synthetic.numFeaturesPadded;
+
+		double rowBytes = (double)numFeaturesPadded * sizeof(float);
+
+		std::string csv = "benchmark.csv";
+		std::string bin = "benchmark.bin";
+
+		size_t csvBytes = synthetic.writeCsv(csv);
+		synthetic.writeDataset(bin);
+
+		NaiveBayes nb(numClasses, numFeatures, threads);
+		nb.setVerbose(false);
+
+		// Mapping a dataset only reads its labels
+		run("load_data/dataset", n, n * sizeof(int), [&] { nb.load_data(bin, n); });
+		run("load_data/csv", n, csvBytes, [&] { nb.load_data(csv, n); });
+
+		run("train", n, n * rowBytes, [&] { nb.fit(); });
+
+		nb.compile(EPSILON);
+
+		const NaiveBayes::Engine engines[] = {NaiveBayes::TILED, NaiveBayes::GEMM, NaiveBayes::BF16, NaiveBayes::FP16};
+		const char *names[] = {"TILED", "GEMM", "BF16", "FP16"};
+
+		for (int e = 0; e < 4; e++) {
+			// The quantized engines read one byte per feature once coded
+			double bytes = (engines[e] == NaiveBayes::BF16 || engines[e] == NaiveBayes::FP16) ? n * (double)numFeaturesPadded : n * rowBytes;
+
+			nb.setEngine(engines[e]);
+			run(std::string("classifySW/") + names[e], n, bytes, [&] { nb.classify(EPSILON, NaiveBayes::SW); });
+		}
+
+		nb.setEngine(NaiveBayes::TILED);
+
+		if (hw) {
+			run("classifyHW", n, n * rowBytes, [&] { nb.classify(EPSILON, NaiveBayes::HW); });
+			run("classifyAuto", n, n * rowBytes, [&] { nb.classify(EPSILON, NaiveBayes::AUTO); });
+			run("classifyHybrid", n, n * rowBytes, [&] { nb.classify(EPSILON, NaiveBayes::HYBRID); });
+		}
+
+		std::vector<float> x = synthetic.unpadded();
+		std::vector<int> out((size_t)n * std::max(MODELS, TOPK));
+		std::vector<float> logProbabilities((size_t)n * TOPK);
+		int k = std::min(TOPK, numClasses);
+
+		run("predict", n, n * (double)numFeatures * sizeof(float), [&] { nb.predict(x.data(), n, out.data()); });
+		run("predict_topk", n, n * (double)numFeatures * sizeof(float), [&] { nb.predict_topk(x.data(), n, k, out.data(), logProbabilities.data()); });
+
+		Model model = nb.getModel();
+
+		ModelSet set(numFeatures, numFeaturesPadded);
+		for (int m = 0; m < MODELS; m++) {
+			set.add(model);
+		}
+
+		run("ModelSet", n, n * rowBytes, [&] { set.classify(synthetic.features.data(), n, out.data()); });
+
+		Csr examples(numFeatures);
+		for (int i = 0; i < n; i++) {
+			examples.append(synthetic.labels[i], &synthetic.features[(size_t)i * numFeaturesPadded]);
+		}
+
+		SparseModel sparse;
+		sparse.compile(model);
+
+		double sparseBytes = examples.values.size() * (sizeof(float) + sizeof(int)) + (n + 1) * sizeof(long long);
+		run("SparseModel", n, sparseBytes, [&] { sparse.classify(examples, out.data()); });
+
+		remove(csv.c_str());
+		remove(bin.c_str());
+	}
+
+	void json(std::string filename, const Synthetic &synthetic) const {
+		std::ofstream file(filename);
+
+		char date[32];
+		time_t now = time(nullptr);
+		strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+		file << std::setprecision(6) << std::fixed;
+		file << "{\n";
+		file << "  \"context\": {\n";
+		file << "    \"date\": \"" << date << "\",\n";
+		file << "    \"threads\": " << threads << ",\n";
+		file << "    \"isa\": \"" << kernels::name(kernels::isa()) << "\",\n";
+		file << "    \"examples\": " << synthetic.numExamples << ",\n";
+		file << "    \"classes\": " << synthetic.numClasses << ",\n";
+		file << "    \"features\": " << synthetic.numFeatures << ",\n";
+		file << "    \"seed\": " << SEED << ",\n";
+		file << "    \"repetitions\": " << repetitions << "\n";
+		file << "  },\n";
+		file << "  \"benchmarks\": [\n";
+
+		for (size_t i = 0; i < results.size(); i++) {
+			const Result &result = results[i];
+			double median = result.median();
+
+			file << "    {\n";
+			file << "      \"name\": \"" << result.name << "\",\n";
+			file << "      \"rows\": " << result.rows << ",\n";
+			file << "      \"bytes\": " << result.bytes << ",\n";
+			file << "      \"ns\": [";
+			for (size_t r = 0; r < result.ns.size(); r++) {
+				file << (r ? ", " : "") << result.ns[r];
+			}
+			file << "],\n";
+			file << "      \"median_ns\": " << median << ",\n";
+			file << "      \"mean_ns\": " << result.mean() << ",\n";
+			file << "      \"stddev_ns\": " << result.stddev() << ",\n";
+			file << "      \"min_ns\": " << result.min() << ",\n";
+			file << "      \"ns_per_row\": " << median / result.rows << ",\n";
+			file << "      \"rows_per_second\": " << result.rows / median * 1e9 << ",\n";
+			file << "      \"gb_per_second\": " << result.bytes / median << "\n";
+			file << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+
+		file << "  ]\n";
+		file << "}\n";
+	}
+};
+
+int main(int argc, const char *argv[]) {
+	if (argc < 5 || argc > 8) {
+		std::cout << "Usage: ./" << argv[0] << " <CPU threads> <examples> <classes> <features> [repetitions] [JSON output] [HW:1]\n";
+		exit(-1);
+	}
+
+	const int threads = std::atoi(argv[1]);
+	const int examples = std::atoi(argv[2]);
+	const int classes = std::atoi(argv[3]);
+	const int features = std::atoi(argv[4]);
+	const int repetitions = (argc > 5) ? std::atoi(argv[5]) : REPETITIONS;
+	const std::string output = (argc > 6) ? argv[6] : "benchmark.json";
+	const bool hw = (argc > 7) && std::atoi(argv[7]);
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "\n -- Generating " << examples << " examples x " << classes << " classes x " << features << " features\n\n";
+
+	Synthetic synthetic(examples, classes, features, SEED);
+
+	Benchmark benchmark(threads, repetitions);
+	benchmark.suite(synthetic, hw);
+	benchmark.json(output, synthetic);
+
+	std::cout << "\n -- Results written to " << output << "\n\n";
+
+	return 0;
+}
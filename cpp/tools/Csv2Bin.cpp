@@ -0,0 +1,61 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "Csv.h"
+#include "Dataset.h"
+
+#define VECTORIZATION 8 // Vectorization of features in HW
+#define BATCH 65536 // Examples parsed per read
+
+int main(int argc, const char *argv[]) {
+	if (argc != 4) {
+		std::cout << "Usage: ./" << argv[0] << " <input CSV> <output dataset> <features>\n";
+		exit(-1);
+	}
+
+	const int numFeatures = std::atoi(argv[3]);
+	const int numFeaturesPadded = (numFeatures + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1));
+
+	Csv csv;
+	csv.open(argv[1]);
+
+	std::vector<int> labels;
+	std::vector<float> features;
+
+	int rows = 0;
+	int count;
+
+	do {
+		labels.resize(rows + BATCH);
+		features.resize((size_t)(rows + BATCH) * numFeaturesPadded);
+
+		count = csv.read(BATCH, numFeatures, numFeaturesPadded, &labels[rows], &features[(size_t)rows * numFeaturesPadded]);
+		rows += count;
+	} while (count == BATCH);
+
+	labels.resize(rows);
+	features.resize((size_t)rows * numFeaturesPadded);
+
+	Dataset::write(argv[2], labels.data(), features.data(), labels.size(), numFeatures, numFeaturesPadded);
+
+	std::cout << "Wrote " << labels.size() << " examples x " << numFeatures << " features to " << argv[2] << "\n";
+
+	return 0;
+}
@@ -0,0 +1,153 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <ap_int.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "Model.h"
+#include "Statistics.h"
+#include "Synthetic.h"
+
+// Kernel shape, as built by the Makefile
+#ifndef VECTOR_SIZE
+#define VECTOR_SIZE 8
+#endif
+#define SEED 42 // Seed of the synthetic datasets
+#define EPSILON 0.05f // Variance smoothing
+#define TOLERANCE 1e-4f // Relative score gap below which a different class is a tie
+
+typedef ap_int<32 * VECTOR_SIZE> floatV;
+
+// The Classifier kernel and the class-parallel one, built from the same source
+extern "C" void Classifier_0(floatV *_features, floatV *_means, floatV *_variances, float *_priors, int *_prediction, float epsilon, int numClasses, int numFeatures, int chunkSize);
+extern "C" void Classifier_Parallel(floatV *_features, floatV *_means, floatV *_variances, float *_priors, int *_prediction, float epsilon, int numClasses, int numFeatures, int chunkSize);
+
+typedef void (*Kernel)(floatV *, floatV *, floatV *, float *, int *, float, int, int, int);
+
+// Read by the CYCLES accounting of the kernels
+unsigned long long kernelCycles = 0;
+
+// Packs rows of padded floats into the 256-bit words of the kernel ports
+static std::vector<floatV> pack(const float *x, size_t floats) {
+	std::vector<floatV> words(floats / VECTOR_SIZE);
+
+	for (size_t w = 0; w < words.size(); w++) {
+		for (int t = 0; t < VECTOR_SIZE; t++) {
+			uint32_t bits;
+			memcpy(&bits, &x[w * VECTOR_SIZE + t], sizeof(bits));
+			words[w].range((t + 1) * 32 - 1, t * 32) = bits;
+		}
+	}
+
+	return words;
+}
+
+/**
+* Kernel cycles of the class-parallel kernel against the Classifier kernel.
+*
+* For every class count a synthetic dataset is drawn, trained on by the host
+* code and sent through both kernels as one request. The cycles of the
+* request are reported from the CYCLES accounting of each kernel, and both
+* kernels' predictions are checked against the CPU engine, with the same tie
+* tolerance as csim.
+*/
+int main(int argc, const char *argv[]) {
+	const int numFeatures = (argc > 1) ? std::atoi(argv[1]) : 784;
+	const int numExamples = (argc > 2) ? std::atoi(argv[2]) : 4096;
+
+	std::vector<int> classCounts;
+	for (int a = 3; a < argc; a++) {
+		classCounts.push_back(std::atoi(argv[a]));
+	}
+	if (classCounts.empty()) classCounts = {2, 3, 5, 8, 10, 13, 16, 26, 64};
+
+	if (numFeatures <= 0 || numExamples <= 0 || numExamples % VECTORIZATION) {
+		std::cout << "Usage: ./" << argv[0] << " [features] [examples, a multiple of " << VECTORIZATION << "] [classes ...]\n";
+		exit(-1);
+	}
+
+	const Kernel kernels[] = {Classifier_0, Classifier_Parallel};
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "\n -- One request of " << numExamples << " examples x " << numFeatures << " features\n\n";
+	std::cout << std::setw(10) << "classes" << std::setw(22) << "Classifier cyc/ex" << std::setw(22) << "Parallel cyc/ex" << std::setw(12) << "speedup" << std::setw(14) << "mismatches" << "\n";
+
+	int failures = 0;
+
+	for (int numClasses : classCounts) {
+		Synthetic synthetic(numExamples, numClasses, numFeatures, SEED);
+		int numFeaturesPadded = synthetic.numFeaturesPadded;
+
+		std::vector<float> priors(numClasses);
+		std::vector<float> means((size_t)numClasses * numFeaturesPadded);
+		std::vector<float> variances((size_t)numClasses * numFeaturesPadded);
+
+		Statistics statistics(numClasses, numFeatures, numFeaturesPadded);
+		statistics.accumulate(synthetic.features.data(), synthetic.labels.data(), numExamples);
+		statistics.finalize(priors.data(), means.data(), variances.data());
+
+		Model model;
+		model.compile(numClasses, numFeatures, numFeaturesPadded, priors.data(), means.data(), variances.data(), EPSILON);
+
+		std::vector<float> scores((size_t)numExamples * numClasses);
+		model.score(synthetic.features.data(), numExamples, scores.data());
+
+		std::vector<floatV> kernelFeatures = pack(synthetic.features.data(), synthetic.features.size());
+		std::vector<floatV> kernelMeans = pack(means.data(), means.size());
+		std::vector<floatV> kernelVariances = pack(variances.data(), variances.size());
+
+		unsigned long long cycles[2];
+		int mismatches = 0;
+
+		for (int v = 0; v < 2; v++) {
+			std::vector<int> predictions(numExamples);
+
+			kernelCycles = 0;
+			kernels[v](kernelFeatures.data(), kernelMeans.data(), kernelVariances.data(), priors.data(), predictions.data(), EPSILON, numClasses, numFeatures, numExamples);
+			cycles[v] = kernelCycles;
+
+			for (int i = 0; i < numExamples; i++) {
+				const float *score = &scores[(size_t)i * numClasses];
+				int prediction = std::max_element(score, score + numClasses) - score;
+				int kernel = predictions[i];
+
+				if (kernel == prediction) continue;
+				if (kernel >= 0 && kernel < numClasses && score[prediction] - score[kernel] <= TOLERANCE * fabsf(score[prediction])) continue;
+
+				mismatches++;
+			}
+		}
+
+		failures += mismatches;
+
+		std::cout << std::setw(10) << numClasses
+			<< std::setw(22) << (double)cycles[0] / numExamples
+			<< std::setw(22) << (double)cycles[1] / numExamples
+			<< std::setw(11) << (double)cycles[0] / cycles[1] << "x"
+			<< std::setw(14) << mismatches << "\n";
+	}
+
+	std::cout << "\n";
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <ap_int.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "Kernels.h"
+#include "Model.h"
+#include "Reader.h"
+#include "Statistics.h"
+
+#define VECTORIZATION 8 // Vectorization of features in HW
+
+// Kernel shape, as built by the Makefile
+#ifndef VECTOR_SIZE
+#define VECTOR_SIZE 8
+#endif
+#ifndef TOP_K_MAX
+#define TOP_K_MAX 8
+#endif
+#define PARALLELISM 4096 // Parallelism for chunkSize in HW
+#define BATCH 65536 // Examples read per call
+#define CLOCK_MHZ 250 // Kernel clock for the throughput estimate
+#define TOLERANCE 1e-4f // Relative score gap below which a different class is a tie
+
+typedef ap_int<32 * VECTOR_SIZE> floatV;
+
+#ifdef TOPK
+// Built with TOPK=k: the top-k variant, returning the k best classes
+extern "C" void Classifier_TopK(floatV *_features, floatV *_means, floatV *_variances, float *_priors, int *_classes, float *_logProbabilities, float epsilon, int numClasses, int numFeatures, int chunkSize, int topK);
+#else
+extern "C" void Classifier_0(floatV *_features, floatV *_means, floatV *_variances, float *_priors, int *_prediction, float epsilon, int numClasses, int numFeatures, int chunkSize);
+#endif
+
+// Read by the CYCLES accounting of the kernel
+unsigned long long kernelCycles = 0;
+
+// Packs rows of padded floats into the 256-bit words of the kernel ports
+static std::vector<floatV> pack(const float *x, size_t floats) {
+	std::vector<floatV> words(floats / VECTOR_SIZE);
+
+	for (size_t w = 0; w < words.size(); w++) {
+		for (int t = 0; t < VECTOR_SIZE; t++) {
+			uint32_t bits;
+			memcpy(&bits, &x[w * VECTOR_SIZE + t], sizeof(bits));
+			words[w].range((t + 1) * 32 - 1, t * 32) = bits;
+		}
+	}
+
+	return words;
+}
+
+/**
+* C simulation of the Classifier kernel against the CPU engine.
+*
+* The model is trained on the input file by the host code, and the examples
+* are sent through the kernel in requests of chunkSize examples, as Coral
+* would, and scored by the tiled CPU engine. Predictions are compared and the
+* kernel cycles of every request are reported from its CYCLES accounting.
+* A prediction differing from the CPU one is a tie when the two classes
+* score within TOLERANCE, as the kernel sums its log terms in another order;
+* any other difference fails the run. Built with TOPK=k, the top-k variant
+* is simulated instead, and each of its k classes and log posteriors is
+* compared with kernels::topk on the CPU scores the same way.
+*/
+int main(int argc, const char *argv[]) {
+	if (argc < 4 || argc > 7) {
+		std::cout << "Usage: ./" << argv[0] << " <input file> <classes> <features> [examples] [chunkSize] [epsilon]\n";
+		exit(-1);
+	}
+
+	const int numClasses = std::atoi(argv[2]);
+	const int numFeatures = std::atoi(argv[3]);
+	const int maxExamples = (argc > 4) ? std::atoi(argv[4]) : PARALLELISM;
+	const int chunkSize = (argc > 5) ? std::atoi(argv[5]) : PARALLELISM;
+	const float epsilon = (argc > 6) ? std::atof(argv[6]) : 0.05f;
+
+	if (chunkSize % VECTORIZATION) {
+		std::cout << "chunkSize must be a multiple of " << VECTORIZATION << "\n";
+		exit(-1);
+	}
+
+	const int numFeaturesPadded = (numFeatures + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1));
+
+	Reader reader(numFeatures, numFeaturesPadded);
+	reader.open(argv[1]);
+
+	std::vector<int> labels;
+	std::vector<float> features;
+
+	int numExamples = 0;
+	for (;;) {
+		int rows = std::min(BATCH, maxExamples - numExamples);
+		if (rows <= 0) break;
+
+		labels.resize(numExamples + rows);
+		features.resize((size_t)(numExamples + rows) * numFeaturesPadded);
+
+		rows = reader.read(rows, &labels[numExamples], &features[(size_t)numExamples * numFeaturesPadded]);
+		if (!rows) break;
+		numExamples += rows;
+	}
+
+	// Requests are whole chunks, the last one zero padded
+	int requests = (numExamples + chunkSize - 1) / chunkSize;
+	labels.resize(numExamples);
+	features.resize((size_t)requests * chunkSize * numFeaturesPadded, 0.0f);
+
+	std::vector<float> priors(numClasses);
+	std::vector<float> means((size_t)numClasses * numFeaturesPadded);
+	std::vector<float> variances((size_t)numClasses * numFeaturesPadded);
+
+	Statistics statistics(numClasses, numFeatures, numFeaturesPadded);
+	statistics.accumulate(features.data(), labels.data(), numExamples);
+	statistics.finalize(priors.data(), means.data(), variances.data());
+
+	Model model;
+	model.compile(numClasses, numFeatures, numFeaturesPadded, priors.data(), means.data(), variances.data(), epsilon);
+
+	std::vector<floatV> kernelMeans = pack(means.data(), means.size());
+	std::vector<floatV> kernelVariances = pack(variances.data(), variances.size());
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "\n -- Simulating " << requests << " requests of " << chunkSize << " examples, " << numClasses << " classes x " << numFeatures << " features\n\n";
+
+#ifdef TOPK
+	// The kernel clamps topK to TOP_K_MAX, and kernels::topk to the classes
+	const int topK = std::min(std::min(TOPK, TOP_K_MAX), numClasses);
+#else
+	const int topK = 1;
+#endif
+
+	std::vector<int> kernelPredictions((size_t)chunkSize * topK);
+	std::vector<float> kernelLogProbabilities((size_t)chunkSize * topK);
+	std::vector<int> classes(topK);
+	std::vector<float> logProbabilities(topK);
+	std::vector<float> scores((size_t)chunkSize * numClasses);
+
+	int ties = 0, mismatches = 0, correct = 0;
+	unsigned long long totalCycles = 0;
+
+	for (int r = 0; r < requests; r++) {
+		const float *x = &features[(size_t)r * chunkSize * numFeaturesPadded];
+		std::vector<floatV> kernelFeatures = pack(x, (size_t)chunkSize * numFeaturesPadded);
+
+		kernelCycles = 0;
+#ifdef TOPK
+		Classifier_TopK(kernelFeatures.data(), kernelMeans.data(), kernelVariances.data(), priors.data(), kernelPredictions.data(), kernelLogProbabilities.data(),
+			epsilon, numClasses, numFeatures, chunkSize, topK);
+#else
+		Classifier_0(kernelFeatures.data(), kernelMeans.data(), kernelVariances.data(), priors.data(), kernelPredictions.data(), epsilon, numClasses, numFeatures, chunkSize);
+#endif
+		totalCycles += kernelCycles;
+
+		model.score(x, chunkSize, scores.data());
+
+		int rows = std::min(chunkSize, numExamples - r * chunkSize);
+		for (int i = 0; i < rows; i++) {
+			const float *score = &scores[(size_t)i * numClasses];
+			kernels::topk(score, numClasses, topK, classes.data(), logProbabilities.data());
+
+			if (kernelPredictions[(size_t)i * topK] == labels[r * chunkSize + i]) correct++;
+
+			for (int t = 0; t < topK; t++) {
+				int prediction = classes[t];
+				int kernel = kernelPredictions[(size_t)i * topK + t];
+				float tolerance = TOLERANCE * fabsf(score[prediction]);
+
+#ifdef TOPK
+				// Log posteriors agree like the scores they come from
+				float logProbability = kernelLogProbabilities[(size_t)i * topK + t];
+				bool same = (logProbability == logProbabilities[t]) || fabsf(logProbability - logProbabilities[t]) <= tolerance;
+#else
+				bool same = true;
+#endif
+
+				if (kernel == prediction && same) continue;
+
+				if (kernel >= 0 && kernel < numClasses && same && (score[prediction] == score[kernel] || fabsf(score[prediction] - score[kernel]) <= tolerance)) {
+					ties++;
+				} else {
+					if (mismatches < 10) {
+						std::cout << " -- Example " << r * chunkSize + i << ", rank " << t << ": kernel " << kernel << ", CPU " << prediction << "\n";
+					}
+					mismatches++;
+				}
+			}
+		}
+
+		std::cout << " -- Request " << r << ": " << kernelCycles << " cycles, " << (double)kernelCycles / chunkSize << " cycles/example\n";
+	}
+
+	double seconds = totalCycles / (CLOCK_MHZ * 1e6);
+	std::cout << "\n -- Kernel: " << totalCycles << " cycles, " << (double)totalCycles / requests << " cycles/request, "
+		<< numExamples / seconds << " examples/s per CU at " << CLOCK_MHZ << "MHz\n";
+	std::cout << " -- Accuracy: " << (100 * (float)(correct) / numExamples) << " % (" << correct << "/" << numExamples << ")\n";
+	std::cout << " -- CPU agreement: " << mismatches << " mismatches, " << ties << " ties\n\n";
+
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/**
+* Copyright © 2018-2021 InAccel
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Dataset.h"
+
+#ifndef VECTORIZATION
+#define VECTORIZATION 8 // Vectorization of features in HW
+#endif
+
+/**
+* Deterministic synthetic Gaussian dataset. Every class draws its per-feature
+* means and standard deviations once, and every example draws a class and
+* then its features around them. Only mt19937_64 and Box-Muller are used, so
+* the same arguments give the same bytes with any standard library.
+*/
+class Synthetic {
+private:
+	std::mt19937_64 random;
+
+	double uniform() {
+		return ((random() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+	}
+
+	double normal() {
+		return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+	}
+
+public:
+	int numExamples;
+	int numClasses;
+	int numFeatures;
+	int numFeaturesPadded;
+
+	std::vector<int> labels;
+	std::vector<float> features; // [numExamples][numFeaturesPadded], zero padded
+
+	Synthetic(int numExamples, int numClasses, int numFeatures, uint64_t seed): random(seed), numExamples(numExamples), numClasses(numClasses), numFeatures(numFeatures),
+			numFeaturesPadded((numFeatures + (VECTORIZATION - 1)) & (~(VECTORIZATION - 1))) {
+		std::vector<float> means((size_t)numClasses * numFeatures);
+		std::vector<float> deviations((size_t)numClasses * numFeatures);
+
+		for (size_t i = 0; i < means.size(); i++) {
+			means[i] = 2 * normal();
+			deviations[i] = 0.5 + 1.5 * uniform();
+		}
+
+		labels.resize(numExamples);
+		features.assign((size_t)numExamples * numFeaturesPadded, 0.0f);
+
+		for (int i = 0; i < numExamples; i++) {
+			int k = random() % numClasses;
+			labels[i] = k;
+
+			for (int j = 0; j < numFeatures; j++) {
+				features[(size_t)i * numFeaturesPadded + j] = means[(size_t)k * numFeatures + j] + deviations[(size_t)k * numFeatures + j] * normal();
+			}
+		}
+	}
+
+	// Returns the size of the file
+	size_t writeCsv(std::string filename) const {
+		FILE *file = fopen(filename.c_str(), "w");
+		if (!file) {
+			std::cerr << "Cannot write " << filename << "\n";
+			exit(-1);
+		}
+
+		for (int i = 0; i < numExamples; i++) {
+			fprintf(file, "%d", labels[i]);
+			for (int j = 0; j < numFeatures; j++) {
+				fprintf(file, ",%.5g", features[(size_t)i * numFeaturesPadded + j]);
+			}
+			fputc('\n', file);
+		}
+
+		size_t bytes = ftell(file);
+		fclose(file);
+
+		return bytes;
+	}
+
+	void writeDataset(std::string filename) const {
+		Dataset::write(filename, labels.data(), features.data(), numExamples, numFeatures, numFeaturesPadded);
+	}
+
+	// Rows of numFeatures floats, as taken by the low-latency API
+	std::vector<float> unpadded() const {
+		std::vector<float> x((size_t)numExamples * numFeatures);
+		for (int i = 0; i < numExamples; i++) {
+			std::copy(&features[(size_t)i * numFeaturesPadded], &features[(size_t)i * numFeaturesPadded + numFeatures], &x[(size_t)i * numFeatures]);
+		}
+
+		return x;
+	}
+};
+
+#endif // SYNTHETIC_H